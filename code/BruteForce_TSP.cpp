@@ -13,13 +13,11 @@
 #include <string>   
 #include <iomanip>
 
-using namespace std;
+#include "TSP_Common.h"
+#include "TSP_MST.h"
 
+using namespace std;
 
-//Point struct: Stores a city location (x,y).
-struct Point {
-    double x, y;
-};
 
 // SVG solution section
 void writeSolutionSVG(const vector<Point>& points, const vector<int>& bestTour, float gridSize, const string& outname)
@@ -78,28 +76,6 @@ void writeSolutionSVG(const vector<Point>& points, const vector<int>& bestTour,
 }
 
 
-//distEuclid: finds distance
-double distEuclid(const Point& a, const Point& b) {
-    double dx = a.x - b.x;     //difference in x
-    double dy = a.y - b.y;     //difference in y
-    return sqrt(dx*dx + dy*dy);
-}
-
-
-//loadPoints: Reads points from a text file into the 'points' vector. Returns true if successful, false otherwise.
-bool loadPoints(const string& filename, vector<Point>& points) {
-    ifstream in(filename);          
-    if (!in.is_open()) return false;
-
-    Point p;
-    while (in >> p.x >> p.y) {      //read until EOF
-        points.push_back(p);        //store each city
-    }
-
-    //return true only if we got at least one point
-    return !points.empty();
-}
-
 int main(int argc, char* argv[]) {
     //argc counts how many command line pieces exist.
     if (argc < 2) {
@@ -111,7 +87,12 @@ int main(int argc, char* argv[]) {
     vector<Point> points;
 
     //Load cities from Alex's random generator
-    if (!loadPoints(filename, points)) {
+    bool loaded;
+    {
+        TSP_PHASE("load");
+        loaded = loadPoints(filename, points);
+    }
+    if (!loaded) {
         cout << "Error: couldn't read points from " << filename << "\n";
         return 1;
     }
@@ -129,11 +110,10 @@ int main(int argc, char* argv[]) {
         Using this to avoid doing sqrt over and over.
         Time to build: O(n^2).
     */
-    vector<vector<double>> d(n, vector<double>(n, 0.0));
-    for (int i = 0; i < n; i++) {
-        for (int j = 0; j < n; j++) {
-            d[i][j] = distEuclid(points[i], points[j]);
-        }
+    vector<vector<double>> d;
+    {
+        TSP_PHASE("distance_matrix");
+        d = buildDistanceMatrix(points);
     }
 
     /*
@@ -158,39 +138,60 @@ int main(int argc, char* argv[]) {
     */
     sort(perm.begin(), perm.end());
 
-    do {
-        double len = 0.0;
-        int prev = 0; 
+    {
+        TSP_PHASE("permutations");
+#ifdef TSP_STATS
+        long long evaluated = 0;   //kept out of the normal build's innermost loop
+#endif
+        do {
+#ifdef TSP_STATS
+            evaluated++;
+#endif
+            double len = 0.0;
+            int prev = 0; 
 
     
-        //Add distance from prev -> current city. Prev updates each step.
-        for (int curr : perm) {
-            len += d[prev][curr]; 
-            prev = curr;     
-            if (len >= bestLen) break;
-        }
-
-        //Close cycle, last city back to city 0
-        len += d[prev][0];
-
-        //If this run was the best run, store
-        if (len < bestLen) {
-            bestLen = len;
-
-            //build full tour: 0 + perm + 0
-            bestTour.clear();
-            bestTour.push_back(0);
-            bestTour.insert(bestTour.end(),
-                            perm.begin(), perm.end());
-            bestTour.push_back(0);
-        }
-
-    } while (next_permutation(perm.begin(), perm.end()));
+            //Add distance from prev -> current city. Prev updates each step.
+            for (int curr : perm) {
+                len += d[prev][curr]; 
+                prev = curr;     
+                if (len >= bestLen) break;
+            }
+
+            //Close cycle, last city back to city 0
+            len += d[prev][0];
+
+            //If this run was the best run, store
+            if (len < bestLen) {
+                bestLen = len;
+
+                //build full tour: 0 + perm + 0
+                bestTour.clear();
+                bestTour.push_back(0);
+                bestTour.insert(bestTour.end(),
+                                perm.begin(), perm.end());
+                bestTour.push_back(0);
+            }
+
+        } while (next_permutation(perm.begin(), perm.end()));
+#ifdef TSP_STATS
+        TSP_COUNT("permutations_evaluated", evaluated);
+#endif
+    }
 
     
     //Final output
     cout << fixed << setprecision(6);  //formatting
     cout << "Brute-force optimal tour length: " << bestLen << "\n";
+
+    //How far the 1-tree bound sits below the optimum (shows how tight it is for the other solvers)
+    TourBound bound;
+    {
+        TSP_PHASE("lower_bound");
+        bound = tourLowerBound(points);
+    }
+    cout << "1-tree lower bound: " << bound.oneTree << " (MST " << bound.mst << ")\n";
+    cout << "Gap to lower bound: " << boundGap(bestLen, bound.oneTree) << "\n";
     cout << "Tour order: ";
 
     for (size_t i = 0; i < bestTour.size(); i++) {
@@ -213,6 +214,7 @@ int main(int argc, char* argv[]) {
 
     // Call function to make solution SVG
     writeSolutionSVG(points, bestTour, gridSize, base + "_solution");
+    TSP_WRITE_STATS(base + "_bruteForceStats.json", "bruteforce", filename, n, bestLen);
 
     return 0;
 }
@@ -12,57 +12,19 @@
 #include <algorithm>
 #include <iomanip>
 #include <string>
+#include <atomic>
+#include <cstdint>
 
-using namespace std;
-
-//Represents a city in 2D space
-struct Point {
-    double x, y;
-};
-
-//Distance between two points
-double distEuclid(const Point& a, const Point& b) {
-    double dx = a.x - b.x;
-    double dy = a.y - b.y;
-    return std::sqrt(dx*dx + dy*dy);
-}
-
-
-//Reads (x y) pairs line by line from a text file. Returns true if at least one point was read.
-bool loadPoints(const string& filename, vector<Point>& points) {
-    ifstream in(filename);
-    if (!in.is_open()) return false;
-
-    Point p;
-    while (in >> p.x >> p.y) {
-        points.push_back(p);
-    }
-    return !points.empty();
-}
-
-
-//Precompute d[i][j] = distance between city i and city j. Important for making later steps simpler
-vector<vector<double>> buildDistanceMatrix(const vector<Point>& pts) {
-    int n = (int)pts.size();
-    vector<vector<double>> d(n, vector<double>(n, 0.0));
-    for (int i = 0; i < n; i++) {
-        for (int j = 0; j < n; j++) {
-            d[i][j] = distEuclid(pts[i], pts[j]);
-        }
-    }
-    return d;
-}
+#include "TSP_Common.h"
+#include "TSP_MST.h"
+#include "TSP_Matching.h"
+#include "TSP_LocalSearch.h"
 
+#if defined(__AVX2__)
+#include <immintrin.h>
+#endif
 
-//Sum of distances along a closed tour.
-double tourLength(const vector<int>& tour,
-                  const vector<vector<double>>& d) {
-    double len = 0.0;
-    for (size_t i = 0; i + 1 < tour.size(); i++) {
-        len += d[tour[i]][tour[i+1]];
-    }
-    return len;
-}
+using namespace std;
 
 //Prim's algorithm for Minimum Spanning Tree on a complete graph.
 vector<int> primMST(const vector<vector<double>>& d) {
@@ -100,37 +62,352 @@ vector<int> primMST(const vector<vector<double>>& d) {
 }
 
 
-//Convert parent[] representation of MST into adjacency list. For each v>0: edge (v, parent[v]).
-vector<vector<int>> buildAdjFromParent(const vector<int>& parent) {
+/*
+    Same Prim's algorithm, but without the distance matrix (O(n) memory).
+
+    The cities not yet in the tree are kept packed in structure-of-arrays form
+    (x, y, key, parent, id), and one pass over them per iteration both relaxes the keys
+    against the newly added city u and finds the next closest city. Keys are squared
+    distances, so there is no sqrt in the loop. With AVX2 the pass runs 4 cities at a time.
+    Ties go to the smaller city id, like the scan in primMST.
+*/
+vector<int> primMSTNoMatrix(const vector<Point>& pts) {
+    int n = (int)pts.size();
+    vector<double> xs(n), ys(n), key(n, numeric_limits<double>::infinity());
+    vector<int> par(n, -1), id(n), parent(n, -1);
+    for (int i = 0; i < n; i++) {
+        xs[i] = pts[i].x;
+        ys[i] = pts[i].y;
+        id[i] = i;
+    }
+
+    int m = n;
+    auto removeAt = [&](int i) {
+        m--;
+        xs[i] = xs[m]; ys[i] = ys[m]; key[i] = key[m]; par[i] = par[m]; id[i] = id[m];
+    };
+
+    //Start MST from city 0
+    int u = 0;
+    removeAt(0);
+
+    while (m > 0) {
+        TSP_COUNT_DIST(m);
+        double ux = pts[u].x, uy = pts[u].y;
+        double bestKey = numeric_limits<double>::infinity();
+        int bestId = n, best = -1;
+        int i = 0;
+
+#if defined(__AVX2__)
+        if (m >= 4) {
+            __m256d vx = _mm256_set1_pd(ux), vy = _mm256_set1_pd(uy);
+            __m128i vu = _mm_set1_epi32(u);
+            __m256d lanesKey = _mm256_set1_pd(bestKey);
+            __m256d lanesId = _mm256_set1_pd((double)n);
+            __m256d lanesPos = _mm256_setzero_pd();
+            __m256d pos = _mm256_setr_pd(0, 1, 2, 3);
+            const __m256d four = _mm256_set1_pd(4.0);
+            const __m256i pick32 = _mm256_setr_epi32(0, 2, 4, 6, 0, 0, 0, 0);
+
+            for (; i + 4 <= m; i += 4) {
+                __m256d dx = _mm256_sub_pd(_mm256_loadu_pd(&xs[i]), vx);
+                __m256d dy = _mm256_sub_pd(_mm256_loadu_pd(&ys[i]), vy);
+                __m256d d2 = _mm256_add_pd(_mm256_mul_pd(dx, dx), _mm256_mul_pd(dy, dy));
+
+                //Relax keys and parents
+                __m256d k = _mm256_loadu_pd(&key[i]);
+                __m256d closer = _mm256_cmp_pd(d2, k, _CMP_LT_OQ);
+                k = _mm256_blendv_pd(k, d2, closer);
+                _mm256_storeu_pd(&key[i], k);
+                __m128i mask32 = _mm256_castsi256_si128(
+                    _mm256_permutevar8x32_epi32(_mm256_castpd_si256(closer), pick32));
+                __m128i p = _mm_loadu_si128((const __m128i*)&par[i]);
+                _mm_storeu_si128((__m128i*)&par[i], _mm_blendv_epi8(p, vu, mask32));
+
+                //Track the smallest key (smaller id on ties) in each lane
+                __m256d ids = _mm256_cvtepi32_pd(_mm_loadu_si128((const __m128i*)&id[i]));
+                __m256d take = _mm256_or_pd(_mm256_cmp_pd(k, lanesKey, _CMP_LT_OQ),
+                                            _mm256_and_pd(_mm256_cmp_pd(k, lanesKey, _CMP_EQ_OQ),
+                                                          _mm256_cmp_pd(ids, lanesId, _CMP_LT_OQ)));
+                lanesKey = _mm256_blendv_pd(lanesKey, k, take);
+                lanesId = _mm256_blendv_pd(lanesId, ids, take);
+                lanesPos = _mm256_blendv_pd(lanesPos, pos, take);
+                pos = _mm256_add_pd(pos, four);
+            }
+
+            alignas(32) double lk[4], li[4], lp[4];
+            _mm256_store_pd(lk, lanesKey);
+            _mm256_store_pd(li, lanesId);
+            _mm256_store_pd(lp, lanesPos);
+            for (int l = 0; l < 4; l++) {
+                if (li[l] < n && (lk[l] < bestKey || (lk[l] == bestKey && (int)li[l] < bestId))) {
+                    bestKey = lk[l];
+                    bestId = (int)li[l];
+                    best = (int)lp[l];
+                }
+            }
+        }
+#endif
+
+        for (; i < m; i++) {
+            double dx = xs[i] - ux, dy = ys[i] - uy;
+            double d2 = dx * dx + dy * dy;
+            if (d2 < key[i]) {
+                key[i] = d2;
+                par[i] = u;
+            }
+            if (key[i] < bestKey || (key[i] == bestKey && id[i] < bestId)) {
+                bestKey = key[i];
+                bestId = id[i];
+                best = i;
+            }
+        }
+
+        u = id[best];
+        parent[u] = par[best];
+        removeAt(best);
+    }
+
+    return parent;
+}
+
+
+//Union-find that several threads can use at once (compare-and-swap, no locks)
+struct ConcurrentSets {
+    vector<atomic<int>> parent;
+
+    explicit ConcurrentSets(int n) : parent(n) {
+        for (int i = 0; i < n; i++) parent[i].store(i, memory_order_relaxed);
+    }
+
+    int find(int x) {
+        while (true) {
+            int p = parent[x].load(memory_order_relaxed);
+            if (p == x) return x;
+            int gp = parent[p].load(memory_order_relaxed);
+            if (gp != p) parent[x].compare_exchange_weak(p, gp, memory_order_relaxed);   //path halving
+            x = gp;
+        }
+    }
+
+    //Always hangs the bigger root under the smaller one, so racing links can't make a cycle
+    bool unite(int a, int b) {
+        while (true) {
+            a = find(a);
+            b = find(b);
+            if (a == b) return false;
+            if (a < b) swap(a, b);
+            int expected = a;
+            if (parent[a].compare_exchange_strong(expected, b, memory_order_relaxed)) return true;
+        }
+    }
+};
+
+/*
+    Parallel Boruvka over the k-nearest-neighbour graph. Drop-in for primMST (same parent[] form).
+
+    Outline:
+        1) Candidate edges = every (i, j) with j in i's k-nearest list, sorted once by length.
+           An edge's rank in that order is its key, so all ties break the same way everywhere.
+        2) Each round, in parallel over cities: walk the city's incident edges in rank order
+           (with a cursor that never goes back) to its cheapest edge leaving its component,
+           and atomic-min that rank into the component's slot
+        3) In parallel over components: add the chosen edge and link the two components
+        4) Stop when no component has a candidate edge left
+
+    The result is the MST of the k-NN graph, which is almost always the true MST. If the k-NN
+    graph is disconnected (far apart clusters), the leftover components are joined with
+    Kruskal over the Delaunay edges, which always contain the cheapest connections.
+*/
+vector<int> boruvkaMST(const vector<Point>& pts, int k, ThreadPool& pool) {
+    int n = (int)pts.size();
+    NeighborLists nbrs = buildNeighborLists(pts, k, &pool);
+
+    //Candidate edges, each pair once, sorted by (length, u, v)
+    auto listed = [&](int i, int j) {
+        for (int t = 0; t < nbrs.k; t++) {
+            if (nbrs.of(i)[t] == j) return true;
+        }
+        return false;
+    };
+    vector<pair<int, int>> edges;
+    edges.reserve((size_t)n * nbrs.k);
+    for (int i = 0; i < n; i++) {
+        for (int t = 0; t < nbrs.k; t++) {
+            int j = nbrs.of(i)[t];
+            if (i < j || !listed(j, i)) edges.push_back({min(i, j), max(i, j)});
+        }
+    }
+    int m = (int)edges.size();
+    vector<double> len(m);
+    vector<int> order(m);
+    for (int e = 0; e < m; e++) {
+        len[e] = distEuclid(pts[edges[e].first], pts[edges[e].second]);
+        order[e] = e;
+    }
+    sort(order.begin(), order.end(), [&](int a, int b) {
+        return len[a] < len[b] || (len[a] == len[b] && edges[a] < edges[b]);
+    });
+
+    //Incident edge ranks per city (CSR), ascending because we fill in rank order
+    vector<int> start(n + 1, 0), inc(2 * (size_t)m), cursor(n);
+    for (auto& e : edges) {
+        start[e.first + 1]++;
+        start[e.second + 1]++;
+    }
+    for (int i = 0; i < n; i++) start[i + 1] += start[i];
+    vector<int> fill(start.begin(), start.end() - 1);
+    vector<pair<int, int>> ranked(m);
+    for (int r = 0; r < m; r++) {
+        ranked[r] = edges[order[r]];
+        inc[fill[ranked[r].first]++] = r;
+        inc[fill[ranked[r].second]++] = r;
+    }
+    for (int i = 0; i < n; i++) cursor[i] = start[i];
+
+    const int NONE = numeric_limits<int>::max();
+    ConcurrentSets sets(n);
+    vector<atomic<int>> compBest(n);
+    for (int i = 0; i < n; i++) compBest[i].store(NONE, memory_order_relaxed);
+    vector<char> inTree(m, 0);
+
+    int chunks = pool.size() * 8;
+    int chunkSize = (n + chunks - 1) / chunks;
+    atomic<bool> found{true};
+
+    while (found) {
+        found = false;
+
+        //Cheapest outgoing edge of every component
+        pool.parallelFor(chunks, [&](int c, int) {
+            for (int i = c * chunkSize; i < min(n, (c + 1) * chunkSize); i++) {
+                int root = sets.find(i);
+                while (cursor[i] < start[i + 1]) {
+                    const pair<int, int>& e = ranked[inc[cursor[i]]];
+                    if (sets.find(e.first) != sets.find(e.second)) break;
+                    cursor[i]++;   //inside the component now, and it stays that way
+                }
+                if (cursor[i] == start[i + 1]) continue;
+
+                int r = inc[cursor[i]];
+                int cur = compBest[root].load(memory_order_relaxed);
+                while (r < cur && !compBest[root].compare_exchange_weak(cur, r, memory_order_relaxed)) {
+                }
+                found.store(true, memory_order_relaxed);
+            }
+        });
+
+        //Add those edges
+        pool.parallelFor(chunks, [&](int c, int) {
+            for (int i = c * chunkSize; i < min(n, (c + 1) * chunkSize); i++) {
+                int r = compBest[i].load(memory_order_relaxed);
+                if (r == NONE) continue;
+                compBest[i].store(NONE, memory_order_relaxed);
+                if (sets.unite(ranked[r].first, ranked[r].second)) inTree[r] = 1;
+            }
+        });
+    }
+
+    vector<pair<int, int>> tree;
+    tree.reserve(n - 1);
+    for (int r = 0; r < m; r++) {
+        if (inTree[r]) tree.push_back(ranked[r]);
+    }
+
+    //Disconnected k-NN graph: finish with Kruskal over Delaunay edges between components
+    if ((int)tree.size() < n - 1) {
+        vector<pair<int, int>> cand = Delaunay::edges(pts);
+        vector<double> clen(cand.size());
+        vector<int> byLen(cand.size());
+        for (size_t e = 0; e < cand.size(); e++) {
+            clen[e] = distEuclid(pts[cand[e].first], pts[cand[e].second]);
+            byLen[e] = (int)e;
+        }
+        sort(byLen.begin(), byLen.end(), [&](int a, int b) { return clen[a] < clen[b]; });
+        for (int e : byLen) {
+            if (sets.unite(cand[e].first, cand[e].second)) tree.push_back(cand[e]);
+        }
+    }
+
+    return parentFromEdges(n, tree);
+}
+
+
+/*
+    The tree + matching multigraph, CSR style in one arena.
+
+    Vertex u owns the slots [start[u], start[u + 1]); the first deg[u] are filled with
+    (neighbor, edge id). Every edge gets one id, stored at both ends, so the Euler walk can mark
+    an edge used from either side. The arena is sized once, so adding an edge never allocates.
+
+    Slots fill in the order edges are added (tree edges, then matching edges), the same order
+    the old vector<vector<int>> adjacency got them in. The Euler walk depends on that order, so
+    keep it: it is what makes the default tour the same as before.
+*/
+struct MultiGraph {
+    vector<int> start;   //n + 1 slot offsets
+    vector<int> deg;     //slots used so far
+    vector<int> nbr;     //neighbor in each slot
+    vector<int> eid;     //edge id in each slot
+    int edges = 0;
+
+    //capacity[u] = how many edges u will ever get
+    explicit MultiGraph(const vector<int>& capacity) : start(capacity.size() + 1, 0), deg(capacity.size(), 0) {
+        for (size_t u = 0; u < capacity.size(); u++) start[u + 1] = start[u] + capacity[u];
+        nbr.resize(start.back());
+        eid.resize(start.back());
+    }
+
+    int size() const { return (int)deg.size(); }
+
+    void addEdge(int u, int v) {
+        int e = edges++;
+        int su = start[u] + deg[u]++, sv = start[v] + deg[v]++;
+        nbr[su] = v;
+        eid[su] = e;
+        nbr[sv] = u;
+        eid[sv] = e;
+    }
+};
+
+/*
+    Convert parent[] representation of MST into the multigraph. For each v>0: edge (v, parent[v]),
+    added in order of v (v's slot gets parent[v], parent[v]'s slot gets v, as before).
+    Two passes: count tree degrees, then fill. An odd-degree vertex gets exactly one matching
+    edge later, so it is given one spare slot up front.
+*/
+MultiGraph buildGraphFromParent(const vector<int>& parent) {
     int n = (int)parent.size();
-    vector<vector<int>> adj(n);
+    vector<int> capacity(n, 0);
     for (int v = 1; v < n; v++) {
-        int p = parent[v];
-        adj[v].push_back(p);
-        adj[p].push_back(v);
+        capacity[v]++;
+        capacity[parent[v]]++;
     }
-    return adj;
+    for (int u = 0; u < n; u++) capacity[u] += capacity[u] & 1;
+
+    MultiGraph g(capacity);
+    for (int v = 1; v < n; v++) g.addEdge(v, parent[v]);
+    return g;
 }
 
 
-//Returns all vertices that have an odd degree in the given adjacency list.
-vector<int> findOddDegreeVertices(const vector<vector<int>>& adj) {
-    int n = (int)adj.size();
+//Returns all vertices that have an odd degree in the given multigraph.
+vector<int> findOddDegreeVertices(const MultiGraph& g) {
+    int n = g.size();
     vector<int> odd;
     for (int i = 0; i < n; i++) {
-        if (adj[i].size() % 2 == 1) {
+        if (g.deg[i] % 2 == 1) {
             odd.push_back(i);
         }
     }
     return odd;
 }
 
-//Combine adjacent unmatched vertices
-void addGreedyPerfectMatching(const vector<int>& odd,
-                              const vector<vector<double>>& d,
-                              vector<vector<int>>& adj) {
+//Combine adjacent unmatched vertices (returns index pairs into odd)
+vector<pair<int, int>> greedyOddPairs(const vector<int>& odd, const vector<Point>& pts) {
     int k = (int)odd.size();
-    if (k == 0) return;
+    vector<pair<int, int>> pairs;
+    if (k == 0) return pairs;
 
     vector<bool> used(k, false);
 
@@ -143,7 +420,7 @@ void addGreedyPerfectMatching(const vector<int>& odd,
         //find closest unmatched partner for odd[i]
         for (int j = i + 1; j < k; j++) {
             if (!used[j]) {
-                double dist = d[odd[i]][odd[j]];
+                double dist = distEuclid(pts[odd[i]], pts[odd[j]]);
                 if (dist < best) {
                     best = dist;
                     bestj = j;
@@ -154,40 +431,134 @@ void addGreedyPerfectMatching(const vector<int>& odd,
         //mark both as matched
         used[i] = true;
         used[bestj] = true;
+        pairs.push_back({i, bestj});
+    }
+    return pairs;
+}
+
+//Add matched pairs (index pairs into odd) to the multigraph
+void addMatchingEdges(const vector<int>& odd,
+                      const vector<pair<int, int>>& pairs,
+                      MultiGraph& g) {
+    for (const auto& pr : pairs) {
+        //add edge (u,v) to the multigraph
+        g.addEdge(odd[pr.first], odd[pr.second]);
+    }
+}
+
+void addGreedyPerfectMatching(const vector<int>& odd,
+                              const vector<Point>& pts,
+                              MultiGraph& g) {
+    addMatchingEdges(odd, greedyOddPairs(odd, pts), g);
+}
 
-        int u = odd[i];
-        int v = odd[bestj];
+//Shortest-first greedy over k-nearest candidate pairs (not order dependent, O(k) per odd vertex)
+void addGlobalGreedyMatching(const vector<int>& odd,
+                             const vector<Point>& pts,
+                             int k,
+                             MultiGraph& g) {
+    addMatchingEdges(odd, globalGreedyPairs(odd, pts, k), g);
+}
 
-        //add edge (u,v) to the multigraph adjacency list
-        adj[u].push_back(v);
-        adj[v].push_back(u);
+/*
+    Exact min-weight perfect matching of the odd vertices, solved over a sparse candidate graph:
+    the k nearest odd neighbours of each odd vertex plus the global greedy pairs (so a perfect
+    matching always exists). Optimal for that graph, which in practice is the true optimum.
+*/
+void addBlossomMatching(const vector<int>& odd,
+                        const vector<Point>& pts,
+                        int k,
+                        MultiGraph& g) {
+    int m = (int)odd.size();
+    if (m == 0) return;
+
+    vector<pair<int, int>> edges = oddCandidateEdges(odd, pts, min(k, m - 1), globalGreedyPairs(odd, pts, k));
+    TSP_COUNT("matching_candidate_edges", edges.size());
+    vector<double> cost(edges.size());
+    for (size_t e = 0; e < edges.size(); e++) cost[e] = distEuclid(pts[odd[edges[e].first]], pts[odd[edges[e].second]]);
+
+    vector<int> mate = BlossomMatching::solve(m, edges, cost);
+    vector<int> left;
+    for (int i = 0; i < m; i++) {
+        if (mate[i] > i) {
+            g.addEdge(odd[i], odd[mate[i]]);
+        } else if (mate[i] < 0) {
+            left.push_back(odd[i]);
+        }
     }
+
+    //Shouldn't happen (the greedy pairs are candidates), but never leave an odd degree behind
+    addGreedyPerfectMatching(left, pts, g);
 }
 
-//Find a good cycle using Hierholzer's algorithm
+/*
+    Find a good cycle using Hierholzer's algorithm.
+
+    Walks the multigraph's arena directly, in the same order as a list-per-vertex version would:
+    u takes its last unused slot (u -> v), and v gives up its first unused slot back to u. Slots
+    to the same neighbor are chained in order, so that first one is found in O(1) amortized
+    even when u and v are joined twice (tree edge + matching edge). Per-slot used flags mark
+    both ends; each vertex's cursor only moves down, past slots already given up.
+    O(V + E) total: no copy of the graph, no find/erase, no allocation per edge.
+*/
 vector<int> eulerianTourHierholzer(int start,
-                                   vector<vector<int>> adj) {
+                                   const MultiGraph& g) {
+    int n = g.size(), slots = g.start[n];
+
+    //partner[s]: the slot at the other end with the same edge id
+    vector<int> partner(slots), seen(g.edges, -1);
+    for (int u = 0; u < n; u++) {
+        for (int s = g.start[u]; s < g.start[u] + g.deg[u]; s++) {
+            int e = g.eid[s];
+            if (seen[e] < 0) {
+                seen[e] = s;
+            } else {
+                partner[s] = seen[e];
+                partner[seen[e]] = s;
+            }
+        }
+    }
+
+    //Chain each vertex's slots to the same neighbor in order; head[first slot] = first unused one
+    vector<int> first(slots), nextSame(slots, -1), head(slots), last(n, -1);
+    for (int u = 0; u < n; u++) {
+        for (int s = g.start[u]; s < g.start[u] + g.deg[u]; s++) {
+            int v = g.nbr[s];
+            if (last[v] < 0) {
+                first[s] = head[s] = s;
+            } else {
+                first[s] = first[last[v]];
+                nextSame[last[v]] = s;
+            }
+            last[v] = s;
+        }
+        for (int s = g.start[u]; s < g.start[u] + g.deg[u]; s++) last[g.nbr[s]] = -1;
+    }
+
+    vector<int> cursor(n);
+    for (int u = 0; u < n; u++) cursor[u] = g.start[u] + g.deg[u] - 1;
+    vector<char> used(slots, 0);
     vector<int> circuit;
-    vector<int> stack; 
+    vector<int> stack;
+    circuit.reserve(g.edges + 1);
+    stack.reserve(g.edges + 1);
 
     stack.push_back(start);
 
     while (!stack.empty()) {
         int u = stack.back();
 
-        if (!adj[u].empty()) {
-            //Take one edge u -> v
-            int v = adj[u].back();
-            adj[u].pop_back();
-
-            //Remove the opposite edge v -> u
-            auto& nbrs = adj[v];
-            auto it = find(nbrs.begin(), nbrs.end(), u);
-            if (it != nbrs.end()) {
-                nbrs.erase(it);
-            }
-
-            //Follow that edge
+        //Skip slots already given up to the other end
+        int& c = cursor[u];
+        while (c >= g.start[u] && used[c]) c--;
+
+        if (c >= g.start[u]) {
+            //Take u's last edge u -> v, remove v's first slot back to u, and follow it
+            int v = g.nbr[c];
+            used[c] = 1;
+            int& h = head[first[partner[c]]];
+            while (used[h]) h = nextSame[h];
+            used[h] = 1;
             stack.push_back(v);
         } else {
             //No more edges out of u: add u to circuit and backtrack
@@ -201,24 +572,8 @@ vector<int> eulerianTourHierholzer(int start,
     return circuit;
 }
 
-//The actual Christofides part using greedy matching
-vector<int> christofidesTour(const vector<vector<double>>& d) {
-    int n = (int)d.size();
-
-    //Build MST
-    vector<int> parent = primMST(d);
-    vector<vector<int>> adj = buildAdjFromParent(parent);
-
-    //Find odd-degree vertices in MST
-    vector<int> odd = findOddDegreeVertices(adj);
-
-    //Greedy min-weight perfect matching on odd vertices
-    addGreedyPerfectMatching(odd, d, adj);
-
-    //Eulerian cycle in the multigraph (make all the degrees even)
-    vector<int> euler = eulerianTourHierholzer(0, adj);
-
-    //Shortcut repeated vertices to get tour
+//Shortcut repeated vertices to get tour: keep the first visit of each vertex
+vector<int> shortcutFirstVisit(const vector<int>& euler, int n) {
     vector<bool> visited(n, false);
     vector<int> tour;
 
@@ -230,6 +585,194 @@ vector<int> christofidesTour(const vector<vector<double>>& d) {
             visited[v] = true;
         }
     }
+    return tour;
+}
+
+/*
+    Shortcut that picks which visit of a repeated vertex to keep.
+
+    The circuit (minus its closing repeat) becomes a cyclic linked list of visits. For a vertex
+    visited more than once, cutting visit j out saves d(prev, v) + d(v, next) - d(prev, next);
+    the visit that saves the most is cut first, neighbors are updated, and this repeats until
+    one visit (the cheapest one to keep) is left.
+*/
+vector<int> shortcutCheapestVisit(const vector<int>& euler, const vector<Point>& pts) {
+    int n = (int)pts.size();
+    int L = (int)euler.size() - 1;
+    if (L <= 1) return shortcutFirstVisit(euler, n);
+
+    vector<int> prv(L), nxt(L);
+    for (int i = 0; i < L; i++) {
+        prv[i] = (i + L - 1) % L;
+        nxt[i] = (i + 1) % L;
+    }
+
+    //Visits grouped by vertex (counting sort)
+    vector<int> first(n + 1, 0), visits(L);
+    for (int i = 0; i < L; i++) first[euler[i] + 1]++;
+    for (int v = 0; v < n; v++) first[v + 1] += first[v];
+    vector<int> fill(first.begin(), first.end() - 1);
+    for (int i = 0; i < L; i++) visits[fill[euler[i]]++] = i;
+
+    vector<char> alive(L, 1);
+    int head = 0;
+    for (int v = 0; v < n; v++) {
+        for (int left = first[v + 1] - first[v]; left > 1; left--) {
+            int cut = -1;
+            double bestSave = -numeric_limits<double>::infinity();
+            for (int t = first[v]; t < first[v + 1]; t++) {
+                int j = visits[t];
+                if (!alive[j]) continue;
+                const Point& p = pts[euler[prv[j]]];
+                const Point& q = pts[euler[nxt[j]]];
+                double save = distEuclid(p, pts[v]) + distEuclid(pts[v], q) - distEuclid(p, q);
+                if (save > bestSave) {
+                    bestSave = save;
+                    cut = j;
+                }
+            }
+            alive[cut] = 0;
+            nxt[prv[cut]] = nxt[cut];
+            prv[nxt[cut]] = prv[cut];
+            if (head == cut) head = nxt[cut];
+        }
+    }
+
+    vector<int> tour;
+    tour.reserve(n + 1);
+    int j = head;
+    do {
+        tour.push_back(euler[j]);
+        j = nxt[j];
+    } while (j != head);
+    return tour;
+}
+
+//Length of an open tour read as a cycle
+double cycleLength(const vector<int>& tour, const vector<Point>& pts) {
+    double len = 0.0;
+    for (size_t i = 0; i < tour.size(); i++) len += distEuclid(pts[tour[i]], pts[tour[(i + 1) % tour.size()]]);
+    return len;
+}
+
+/*
+    Best of many Euler circuits. Circuit 0 is the plain walk from vertex 0; every other circuit
+    shuffles each vertex's edge order and starts from a random vertex (stream i of the seed, so
+    the result doesn't depend on the thread count). Each circuit is shortcut both ways above and
+    the shortest tour over all of them wins (lowest circuit index on ties).
+*/
+vector<int> bestOfManyShortcuts(const MultiGraph& g, const vector<Point>& pts, int circuits,
+                                uint64_t seed, ThreadPool& pool) {
+    int n = g.size();
+    struct Best {
+        double len = numeric_limits<double>::infinity();
+        int circuit = -1;
+        vector<int> tour;
+    };
+    vector<Best> best(pool.size());
+
+    pool.parallelFor(circuits, [&](int i, int worker) {
+        vector<int> euler;
+        if (i == 0) {
+            euler = eulerianTourHierholzer(0, g);
+        } else {
+            CounterRng rng(seed, (uint64_t)i);
+            MultiGraph h = g;
+            for (int u = 0; u < n; u++) {
+                int s0 = h.start[u];
+                for (int a = h.deg[u] - 1; a > 0; a--) {
+                    int b = rng.below(a + 1);
+                    swap(h.nbr[s0 + a], h.nbr[s0 + b]);
+                    swap(h.eid[s0 + a], h.eid[s0 + b]);
+                }
+            }
+            euler = eulerianTourHierholzer(rng.below(n), h);
+        }
+
+        TSP_COUNT("euler_circuit_length", euler.size());
+        Best& mine = best[worker];
+        for (int way = 0; way < 2; way++) {
+            vector<int> tour = (way == 0) ? shortcutFirstVisit(euler, n) : shortcutCheapestVisit(euler, pts);
+            double len = cycleLength(tour, pts);
+            if (len < mine.len || (len == mine.len && i < mine.circuit)) {
+                mine.len = len;
+                mine.circuit = i;
+                mine.tour = move(tour);
+            }
+        }
+    });
+
+    int w = 0;
+    for (int t = 1; t < (int)best.size(); t++) {
+        if (best[t].len < best[w].len || (best[t].len == best[w].len && best[t].circuit < best[w].circuit)) w = t;
+    }
+    return best[w].tour;
+}
+
+//How christofidesTour builds its spanning tree
+enum class MSTMethod { Prim, PrimNoMatrix, Delaunay, Boruvka };
+
+//How christofidesTour pairs up the odd-degree vertices
+enum class MatchMethod { Greedy, GlobalGreedy, Blossom };
+
+//Knobs for christofidesTour (set from the command line in main)
+struct ChristofidesOptions {
+    MSTMethod mst = MSTMethod::Prim;
+    MatchMethod matching = MatchMethod::Greedy;
+    int k = 10;                   //candidate list size for the sparse steps
+    int circuits = 1;             //Euler circuits to shortcut (best one wins)
+    uint64_t seed = 1;            //randomizes circuits 1..circuits-1
+    ThreadPool* pool = nullptr;   //threads for the parallel steps
+};
+
+//The actual Christofides part. d is only needed (and only read) for Prim.
+//If tree is given it receives the spanning tree (parent[] form) for the lower bound.
+vector<int> christofidesTour(const vector<Point>& pts, const vector<vector<double>>& d,
+                             const ChristofidesOptions& opt, vector<int>* tree = nullptr) {
+    int n = (int)pts.size();
+
+    //Build MST (only plain Prim touches the matrix)
+    vector<int> parent;
+    {
+        TSP_PHASE("mst");
+        if (opt.mst == MSTMethod::Delaunay) parent = euclideanMST(pts);
+        else if (opt.mst == MSTMethod::PrimNoMatrix) parent = primMSTNoMatrix(pts);
+        else if (opt.mst == MSTMethod::Boruvka) parent = boruvkaMST(pts, opt.k, *opt.pool);
+        else parent = primMST(d);
+    }
+    MultiGraph g = buildGraphFromParent(parent);
+    if (tree) *tree = parent;
+
+    //Find odd-degree vertices in MST
+    vector<int> odd = findOddDegreeVertices(g);
+    TSP_COUNT("odd_vertices", odd.size());
+
+    //Min-weight perfect matching on odd vertices (greedy, or exact over candidate edges)
+    {
+        TSP_PHASE("matching");
+        if (opt.matching == MatchMethod::Blossom) addBlossomMatching(odd, pts, opt.k, g);
+        else if (opt.matching == MatchMethod::GlobalGreedy) addGlobalGreedyMatching(odd, pts, opt.k, g);
+        else addGreedyPerfectMatching(odd, pts, g);
+    }
+
+    //Eulerian cycle in the multigraph (make all the degrees even)
+    //Shortcut repeated vertices to get tour (or the best of many circuits)
+    vector<int> tour;
+    if (opt.circuits > 1) {
+        TSP_PHASE("euler_and_shortcut");
+        TSP_COUNT("euler_circuits", opt.circuits);
+        tour = bestOfManyShortcuts(g, pts, opt.circuits, opt.seed, *opt.pool);
+    } else {
+        vector<int> euler;
+        {
+            TSP_PHASE("euler");
+            euler = eulerianTourHierholzer(0, g);
+        }
+        TSP_COUNT("euler_circuits", 1);
+        TSP_COUNT("euler_circuit_length", euler.size());
+        TSP_PHASE("shortcut");
+        tour = shortcutFirstVisit(euler, n);
+    }
 
     // Rotate so that tour starts at 0 (helps with consistancy)
     auto it0 = find(tour.begin(), tour.end(), 0);
@@ -300,14 +843,19 @@ void writeSolutionSVG(const vector<Point>& points, const vector<int>& bestTour,
 //Run all this nonsense
 int main(int argc, char* argv[]) {
     if (argc < 2) {
-        cout << "Usage: ./christofides <points_file.txt>\n";
+        cout << "Usage: ./christofides <points_file.txt> [--mst=prim|primfree|delaunay|boruvka] [--matching=greedy|global|blossom] [--k=10] [--circuits=1 --seed=1] [--improve=none|2opt|oropt|lk|anneal|tempering|eax [--parallel] [--budget=10]] [--merge=saved1.out,saved2.out] [--threads=N]\n";
         return 1;
     }
 
     string filename = argv[1];
     vector<Point> points;
 
-    if (!loadPoints(filename, points)) {
+    bool loaded;
+    {
+        TSP_PHASE("load");
+        loaded = loadPoints(filename, points);
+    }
+    if (!loaded) {
         cerr << "Error: could not read points from " << filename << "\n";
         return 1;
     }
@@ -318,16 +866,86 @@ int main(int argc, char* argv[]) {
         return 0;
     }
 
-    //Precompute distances
-    vector<vector<double>> d = buildDistanceMatrix(points);
+    ChristofidesOptions opt;
+    string mstArg = getArg(argc, argv, "mst", "prim");
+    if (mstArg == "primfree") opt.mst = MSTMethod::PrimNoMatrix;
+    else if (mstArg == "delaunay") opt.mst = MSTMethod::Delaunay;
+    else if (mstArg == "boruvka") opt.mst = MSTMethod::Boruvka;
+    else if (mstArg != "prim") {
+        cerr << "Error: unknown MST method " << mstArg << "\n";
+        return 1;
+    }
+    string matchArg = getArg(argc, argv, "matching", "greedy");
+    if (matchArg == "blossom") opt.matching = MatchMethod::Blossom;
+    else if (matchArg == "global") opt.matching = MatchMethod::GlobalGreedy;
+    else if (matchArg != "greedy") {
+        cerr << "Error: unknown matching method " << matchArg << "\n";
+        return 1;
+    }
+    opt.k = stoi(getArg(argc, argv, "k", "10"));
+    if (opt.k < 1) {
+        cerr << "Error: --k must be at least 1\n";
+        return 1;
+    }
+    opt.circuits = stoi(getArg(argc, argv, "circuits", "1"));
+    opt.seed = stoull(getArg(argc, argv, "seed", "1"));
+    string improve = getArg(argc, argv, "improve", "none");
+    if (!knownImprovement(improve)) {
+        cerr << "Error: unknown improvement " << improve << "\n";
+        return 1;
+    }
+    vector<vector<int>> saved;   //tours from earlier runs to merge with (--merge=a.out,b.out)
+    string badTour;
+    if (!loadTours(getArg(argc, argv, "merge", ""), n, saved, badTour)) {
+        cerr << "Error: no tour over " << n << " cities in " << badTour << "\n";
+        return 1;
+    }
+    ThreadPool pool(stoi(getArg(argc, argv, "threads", to_string(ThreadPool::defaultThreads()))));
+    opt.pool = &pool;
+
+    //Precompute distances (only Prim needs them)
+    vector<vector<double>> d;
+    if (opt.mst == MSTMethod::Prim) {
+        TSP_PHASE("distance_matrix");
+        d = buildDistanceMatrix(points);
+    }
 
     //Run the Christofides-style algorithm
-    vector<int> tour = christofidesTour(d);
-    double len = tourLength(tour, d);
+    vector<int> tour, tree;
+    {
+        TSP_PHASE("christofides");
+        tour = christofidesTour(points, d, opt, &tree);
+    }
+
+    //Optional local search on the Christofides tour
+    double built = tourLength(tour, points);
+    improveTour(tour, points, improve, opt.k, &pool, hasFlag(argc, argv, "parallel"), opt.seed,
+                stod(getArg(argc, argv, "budget", "10")));
+
+    //Merge with the saved tours by partition crossover (never longer than the best of them)
+    double unmerged = tourLength(tour, points);
+    if (!saved.empty()) {
+        TSP_PHASE("merge");
+        saved.push_back(tour);
+        for (const vector<int>& t : saved) unmerged = min(unmerged, tourLength(t, points));
+        tour = mergeTours(saved, points);
+    }
+    double len = tourLength(tour, points);
+
+    //Lower bound from the same tree (Boruvka's is only the k-NN graph's MST, so redo that one exactly)
+    TourBound bound;
+    {
+        TSP_PHASE("lower_bound");
+        bound = (opt.mst == MSTMethod::Boruvka) ? tourLowerBound(points) : tourLowerBound(points, tree);
+    }
 
     //Output
     cout << fixed << setprecision(6);
+    if (improve != "none") cout << "Christofides tour length (before " << improve << "): " << built << "\n";
+    if (!saved.empty()) cout << "Best of " << saved.size() << " tours before merging: " << unmerged << "\n";
     cout << "Christofides-style Tour Length: " << len << "\n";
+    cout << "1-tree lower bound: " << bound.oneTree << " (MST " << bound.mst << ")\n";
+    cout << "Gap to lower bound: " << boundGap(len, bound.oneTree) << "\n";
     cout << "Tour order: ";
     for (size_t i = 0; i < tour.size(); i++) {
         cout << tour[i];
@@ -348,6 +966,7 @@ int main(int argc, char* argv[]) {
     cin >> gridSize;
 
     writeSolutionSVG(points, tour, gridSize, base + "_christofidesSolution");
+    TSP_WRITE_STATS(base + "_christofidesStats.json", "christofides", filename, n, len);
 
     return 0;
 }
@@ -11,49 +11,123 @@
 #include <limits> 
 #include <iomanip>
 #include <string>      
+#include <algorithm>
+#include <array>
+#include <cstdint>
+#include <atomic>
+#include <chrono>
+#include <memory>
 
-using namespace std;
-
+#include "TSP_Common.h"
+#include "TSP_LocalSearch.h"
+#include "TSP_MST.h"
 
-//Point struct: Represents a city location in 2D space.
-struct Point {
-    double x, y;
-};
+#if defined(__AVX2__)
+#include <immintrin.h>
+#endif
 
+using namespace std;
 
-//Computes distance between two cities.
-double distEuclid(const Point& a, const Point& b) {
-    double dx = a.x - b.x;
-    double dy = a.y - b.y;
-    return sqrt(dx * dx + dy * dy);
-}
 
+/*
+    Index of the closest city in ids[0..m) as seen from row (a row of the distance matrix).
+    Ties go to the smaller city id, same as scanning the row in order.
+    With AVX2 the distances are gathered 4 at a time and each lane keeps its own best.
+*/
+int argminOver(const double* row, const int* ids, int m) {
+    double bestDist = numeric_limits<double>::infinity();
+    int bestCity = -1;
+    int i = 0;
 
-//Reads city coordinates from file. Returns true if successful, false if file can't open or empty.
-bool loadPoints(const string& filename, vector<Point>& points) {
-    ifstream in(filename);
-    if (!in.is_open()) return false;
+#if defined(__AVX2__)
+    if (m >= 4) {
+        __m256d best = _mm256_set1_pd(bestDist);
+        __m256i bestId = _mm256_set1_epi64x(numeric_limits<long long>::max());
+        const __m256d all = _mm256_castsi256_pd(_mm256_set1_epi64x(-1));
+        for (; i + 4 <= m; i += 4) {
+            __m128i idx = _mm_loadu_si128((const __m128i*)(ids + i));
+            __m256d v = _mm256_mask_i32gather_pd(_mm256_setzero_pd(), row, idx, all, 8);
+            __m256i id = _mm256_cvtepi32_epi64(idx);
+            __m256d lt = _mm256_cmp_pd(v, best, _CMP_LT_OQ);
+            __m256d eq = _mm256_and_pd(_mm256_cmp_pd(v, best, _CMP_EQ_OQ),
+                                       _mm256_castsi256_pd(_mm256_cmpgt_epi64(bestId, id)));
+            __m256d take = _mm256_or_pd(lt, eq);
+            best = _mm256_blendv_pd(best, v, take);
+            bestId = _mm256_castpd_si256(_mm256_blendv_pd(_mm256_castsi256_pd(bestId),
+                                                          _mm256_castsi256_pd(id), take));
+        }
 
-    Point p;
-    while (in >> p.x >> p.y) {   //keep reading x y pairs
-        points.push_back(p);
+        //Combine the 4 lanes
+        alignas(32) double laneDist[4];
+        alignas(32) long long laneId[4];
+        _mm256_store_pd(laneDist, best);
+        _mm256_store_si256((__m256i*)laneId, bestId);
+        for (int l = 0; l < 4; l++) {
+            if (laneId[l] == numeric_limits<long long>::max()) continue;
+            if (laneDist[l] < bestDist || (laneDist[l] == bestDist && laneId[l] < bestCity)) {
+                bestDist = laneDist[l];
+                bestCity = (int)laneId[l];
+            }
+        }
     }
+#endif
 
-    return !points.empty();
+    for (; i < m; i++) {
+        double dist = row[ids[i]];
+        if (dist < bestDist || (dist == bestDist && ids[i] < bestCity)) {
+            bestDist = dist;
+            bestCity = ids[i];
+        }
+    }
+    return bestCity;
 }
 
+/*
+    Roulette pick over the candidates ids[0..m) of one city: candidate i is chosen with
+    probability weight[i] / (total weight of the unvisited ones), u is uniform in [0, 1).
+    slots is UnvisitedSet::slots() (-1 = visited); masked[0..m) is scratch.
+    Returns -1 when every candidate has been visited.
+    With AVX2 the slots are gathered 4 at a time and the visited ones' weights masked to 0.
+*/
+int rouletteOver(const double* weight, const int* ids, int m, const int* slots, double u, double* masked) {
+    double total = 0;
+    int i = 0;
 
-//Precomputes all pairwise distances. This makes the loop faster.
-vector<vector<double>> buildDistanceMatrix(const vector<Point>& pts) {
-    int n = (int)pts.size();
-    vector<vector<double>> d(n, vector<double>(n, 0.0));
-
-    for (int i = 0; i < n; i++) {
-        for (int j = 0; j < n; j++) {
-            d[i][j] = distEuclid(pts[i], pts[j]);
+#if defined(__AVX2__)
+    if (m >= 4) {
+        __m256d sum = _mm256_setzero_pd();
+        const __m128i visited = _mm_set1_epi32(-1);
+        for (; i + 4 <= m; i += 4) {
+            __m128i idx = _mm_loadu_si128((const __m128i*)(ids + i));
+            __m128i live = _mm_cmpgt_epi32(_mm_i32gather_epi32(slots, idx, 4), visited);
+            __m256d w = _mm256_and_pd(_mm256_loadu_pd(weight + i),
+                                      _mm256_castsi256_pd(_mm256_cvtepi32_epi64(live)));
+            _mm256_storeu_pd(masked + i, w);
+            sum = _mm256_add_pd(sum, w);
         }
+
+        alignas(32) double lane[4];
+        _mm256_store_pd(lane, sum);
+        total = (lane[0] + lane[1]) + (lane[2] + lane[3]);
+    }
+#endif
+
+    for (; i < m; i++) {
+        masked[i] = slots[ids[i]] >= 0 ? weight[i] : 0.0;
+        total += masked[i];
+    }
+    if (total <= 0) return -1;
+
+    //Walk the running sum; rounding can leave the target just past the end, so fall back to the last live one
+    double target = u * total;
+    int last = -1;
+    for (i = 0; i < m; i++) {
+        if (masked[i] <= 0) continue;
+        last = i;
+        target -= masked[i];
+        if (target < 0) break;
     }
-    return d;
+    return ids[last];
 }
 
 /*
@@ -61,50 +135,784 @@ vector<vector<double>> buildDistanceMatrix(const vector<Point>& pts) {
         1) Start at city 0
         2) Repeatedly go to the nearest unvisited city
         3) Return to city 0 to close the tour
+
+    The unvisited cities are kept packed in an UnvisitedSet (swap-remove when one is taken),
+    so each step only scans what is left instead of all n entries of the row.
 */
 vector<int> greedyNearestNeighborTour(const vector<vector<double>>& d) {
     int n = (int)d.size();
+    UnvisitedSet left(n);
 
-    vector<bool> visited(n, false); 
     vector<int> tour; 
     tour.reserve(n + 1);
 
     int curr = 0;   //start at city 0
-    visited[curr] = true;
+    left.remove(curr);
     tour.push_back(curr);
 
     //We need to pick the next city (n-1) times
     for (int step = 1; step < n; step++) {
-        double bestDist = numeric_limits<double>::infinity();
-        int bestCity = -1;
+        //Closest of the cities still left
+        curr = argminOver(d[curr].data(), left.data(), left.size());
+        left.remove(curr);
+        tour.push_back(curr);
+    }
+
+    //Return to the starting city
+    tour.push_back(0);
+    return tour;
+}
+
+
+//Which unvisited city an insertion heuristic adds next
+enum class InsertRule { Nearest, Cheapest, Farthest };
+
+//Andrew's monotone chain. Returns the hull cities in counter-clockwise order.
+vector<int> convexHull(const vector<Point>& pts) {
+    int n = (int)pts.size();
+    vector<int> idx(n);
+    for (int i = 0; i < n; i++) idx[i] = i;
+    sort(idx.begin(), idx.end(), [&](int a, int b) {
+        return pts[a].x < pts[b].x || (pts[a].x == pts[b].x && pts[a].y < pts[b].y);
+    });
+
+    auto cross = [&](int o, int a, int b) {
+        return (pts[a].x - pts[o].x) * (pts[b].y - pts[o].y) - (pts[a].y - pts[o].y) * (pts[b].x - pts[o].x);
+    };
 
-        //Scan all cities to find closest unvisited one
-        for (int j = 0; j < n; j++) {
-            if (!visited[j] && d[curr][j] < bestDist) {
-                bestDist = d[curr][j];
-                bestCity = j;
+    vector<int> hull(2 * n);
+    int h = 0;
+    for (int i = 0; i < n; i++) {                       //lower hull
+        while (h >= 2 && cross(hull[h - 2], hull[h - 1], idx[i]) <= 0) h--;
+        hull[h++] = idx[i];
+    }
+    for (int i = n - 2, lower = h + 1; i >= 0; i--) {   //upper hull
+        while (h >= lower && cross(hull[h - 2], hull[h - 1], idx[i]) <= 0) h--;
+        hull[h++] = idx[i];
+    }
+    hull.resize(max(1, h - 1));   //last point repeats the first
+    return hull;
+}
+
+/*
+    Insertion heuristics (nearest, cheapest, farthest), optionally starting from the convex hull.
+
+    Outline:
+        1) Start from a small tour (city 0 plus one partner, or the convex hull)
+        2) Every city outside the tour sits in an indexed heap keyed by
+           - Nearest/Farthest: its distance to the closest tour city
+           - Cheapest: the cost of its best insertion edge
+        3) Pop the best city, splice it into its cheapest edge (a,b) -> (a,c),(c,b)
+        4) Only update keys that the new city / new edges can change
+
+    d != nullptr uses the full matrix. d == nullptr is the sparse mode for big n: distances come
+    from the coordinates and each city only looks at tour edges touching its candidate list nbrs
+    (falling back to a scan of the tour when none of its candidates are in it yet).
+    Cheapest keys whose edge has since been split are fixed lazily when they reach the top.
+*/
+vector<int> insertionTour(const vector<Point>& pts, const vector<vector<double>>* d,
+                          const NeighborLists* nbrs, InsertRule rule, bool hullStart) {
+    int n = (int)pts.size();
+    const double INF = numeric_limits<double>::infinity();
+    auto dist = [&](int a, int b) { return d ? (*d)[a][b] : distEuclid(pts[a], pts[b]); };
+
+    //Tour as a doubly linked cycle. next[c] == -1 means c isn't in the tour yet.
+    vector<int> next(n, -1), prev(n, -1), members;
+    members.reserve(n);
+
+    auto insertAfter = [&](int c, int a) {
+        int b = next[a];
+        next[a] = c; prev[c] = a;
+        next[c] = b; prev[b] = c;
+        members.push_back(c);
+    };
+
+    //Starting tour
+    vector<int> hull;
+    if (hullStart) hull = convexHull(pts);
+    if (hull.size() >= 2) {
+        for (size_t i = 0; i < hull.size(); i++) {
+            next[hull[i]] = hull[(i + 1) % hull.size()];
+            prev[hull[(i + 1) % hull.size()]] = hull[i];
+            members.push_back(hull[i]);
+        }
+    } else {
+        int partner = -1;
+        double best = (rule == InsertRule::Farthest) ? -1.0 : INF;
+        for (int j = 1; j < n; j++) {
+            double dj = dist(0, j);
+            if (rule == InsertRule::Farthest ? dj > best : dj < best) {
+                best = dj;
+                partner = j;
             }
         }
+        next[0] = prev[0] = partner;
+        next[partner] = prev[partner] = 0;
+        members.push_back(0);
+        members.push_back(partner);
+    }
+
+    //Reverse candidate lists: rev[u] = cities that have u as a candidate (sparse mode only)
+    vector<int> revStart, rev;
+    if (!d) {
+        revStart.assign(n + 1, 0);
+        rev.resize(nbrs->ids.size());
+        for (int v : nbrs->ids) revStart[v + 1]++;
+        for (int i = 0; i < n; i++) revStart[i + 1] += revStart[i];
+        vector<int> fill(revStart.begin(), revStart.end() - 1);
+        for (int i = 0; i < n; i++) {
+            for (int t = 0; t < nbrs->k; t++) rev[fill[nbrs->of(i)[t]]++] = i;
+        }
+    }
 
-        //Move to that nearest unvisited city
-        curr = bestCity;
-        visited[curr] = true;
+    //Cheapest edge (a, next[a]) to put c in. Returns a, or -1 if nothing was found.
+    auto bestEdge = [&](int c, bool allowScan, double& cost) {
+        int bestA = -1;
+        cost = INF;
+        auto tryEdge = [&](int a) {
+            double delta = dist(a, c) + dist(c, next[a]) - dist(a, next[a]);
+            if (delta < cost) {
+                cost = delta;
+                bestA = a;
+            }
+        };
+        if (!d) {
+            for (int t = 0; t < nbrs->k; t++) {
+                int u = nbrs->of(c)[t];
+                if (next[u] >= 0) {
+                    tryEdge(u);
+                    tryEdge(prev[u]);
+                }
+            }
+        }
+        if (bestA < 0 && (d || allowScan)) {
+            for (int a : members) tryEdge(a);
+        }
+        return bestA;
+    };
+
+    //Distance from c to the closest tour city (exact scan of the tour)
+    auto scanNearest = [&](int c) {
+        double best = INF;
+        for (int a : members) best = min(best, dist(a, c));
+        return best;
+    };
+
+    IndexedHeap heap(n);
+    vector<double> near(n, INF);   //Nearest/Farthest: distance to the tour found so far
+    vector<int> bestFrom(n, -1), bestTo(n, -1);   //Cheapest: the edge behind each key
+    vector<bool> known(n, true);   //Farthest sparse: false until some tour distance is known
+
+    //Heap key for the Nearest/Farthest rules (farthest is a max-heap, so negate)
+    auto nearKey = [&](int c) { return rule == InsertRule::Farthest ? -near[c] : near[c]; };
+
+    for (int j = 0; j < n; j++) {
+        if (next[j] >= 0) continue;
+        if (rule == InsertRule::Cheapest) {
+            double cost;
+            int a = bestEdge(j, false, cost);
+            bestFrom[j] = a;
+            bestTo[j] = (a >= 0) ? next[a] : -1;
+            heap.set(j, cost);
+        } else {
+            if (d) {
+                near[j] = scanNearest(j);
+            } else {
+                for (int t = 0; t < nbrs->k; t++) {
+                    int u = nbrs->of(j)[t];
+                    if (next[u] >= 0) near[j] = min(near[j], dist(u, j));
+                }
+                known[j] = (near[j] < INF);
+            }
+            heap.set(j, (rule == InsertRule::Farthest && !known[j]) ? -INF : nearKey(j));
+        }
+    }
+
+    while (!heap.empty()) {
+        int c = heap.top();
+
+        //Fix stale keys before trusting them
+        if (rule == InsertRule::Cheapest &&
+            (bestFrom[c] < 0 || next[bestFrom[c]] != bestTo[c])) {
+            double cost;
+            int a = bestEdge(c, true, cost);
+            bestFrom[c] = a;
+            bestTo[c] = next[a];
+            heap.set(c, cost);
+            continue;
+        }
+        if (rule == InsertRule::Farthest && !known[c]) {
+            near[c] = scanNearest(c);
+            known[c] = true;
+            heap.set(c, nearKey(c));
+            continue;
+        }
+        heap.pop();
+
+        int a;
+        if (rule == InsertRule::Cheapest) {
+            a = bestFrom[c];
+        } else {
+            double cost;
+            a = bestEdge(c, true, cost);
+        }
+        int b = next[a];
+        insertAfter(c, a);
+
+        //Only cities that can see the new city / new edges need a look
+        auto update = [&](int j) {
+            if (!heap.contains(j)) return;
+            if (rule == InsertRule::Cheapest) {
+                double viaA = dist(a, j) + dist(j, c) - dist(a, c);
+                double viaB = dist(c, j) + dist(j, b) - dist(c, b);
+                if (viaA < heap.keyOf(j) && viaA <= viaB) {
+                    bestFrom[j] = a; bestTo[j] = c;
+                    heap.set(j, viaA);
+                } else if (viaB < heap.keyOf(j)) {
+                    bestFrom[j] = c; bestTo[j] = b;
+                    heap.set(j, viaB);
+                }
+            } else {
+                double dj = dist(c, j);
+                if (dj < near[j]) {
+                    near[j] = dj;
+                    known[j] = true;
+                    heap.set(j, nearKey(j));
+                }
+            }
+        };
+
+        if (d) {
+            for (int j = 0; j < n; j++) update(j);
+        } else if (rule == InsertRule::Cheapest) {
+            for (int u : {a, c, b}) {
+                for (int s = revStart[u]; s < revStart[u + 1]; s++) update(rev[s]);
+            }
+        } else {
+            for (int s = revStart[c]; s < revStart[c + 1]; s++) update(rev[s]);
+        }
+    }
+
+    //Walk the cycle from city 0 and close it
+    vector<int> tour;
+    tour.reserve(n + 1);
+    int curr = 0;
+    do {
         tour.push_back(curr);
+        curr = next[curr];
+    } while (curr != 0);
+    tour.push_back(0);
+    return tour;
+}
+
+
+/*
+    Clarke-Wright savings with city 0 as the hub.
+
+    Outline:
+        1) Every other city starts as its own route 0 -> i -> 0
+        2) Joining the routes of i and j saves s(i,j) = d(0,i) + d(0,j) - d(i,j)
+        3) Only candidate pairs (j in i's k-nearest list) get a saving, so memory is O(nk)
+        4) Bucket sort the savings and take them biggest first, joining two routes when
+           i and j are both route ends of different routes (otherEnd[] makes that O(1))
+        5) Chain whatever routes are left end to end and hang the result off city 0
+*/
+vector<int> savingsTour(const vector<Point>& pts, const NeighborLists& nbrs) {
+    int n = (int)pts.size();
+    auto dist = [&](int a, int b) { return distEuclid(pts[a], pts[b]); };
+
+    //Candidate pairs and their savings
+    vector<int> pairA, pairB;
+    vector<double> saving;
+    pairA.reserve((size_t)n * nbrs.k);
+    pairB.reserve((size_t)n * nbrs.k);
+    saving.reserve((size_t)n * nbrs.k);
+    double lo = numeric_limits<double>::infinity(), hi = -lo;
+    for (int i = 1; i < n; i++) {
+        for (int t = 0; t < nbrs.k; t++) {
+            int j = nbrs.of(i)[t];
+            if (j <= 0) continue;   //skip the hub (and pairs seen from the other side get rejected anyway)
+            double s = dist(0, i) + dist(0, j) - dist(i, j);
+            pairA.push_back(i);
+            pairB.push_back(j);
+            saving.push_back(s);
+            lo = min(lo, s);
+            hi = max(hi, s);
+        }
     }
 
-    //Return to the starting city
+    //Bucket sort, biggest saving first
+    int m = (int)saving.size();
+    vector<int> order(m);
+    if (m > 0) {
+        double width = (hi > lo) ? (hi - lo) / m : 1.0;
+        auto bucketOf = [&](int e) { return min(m - 1, (int)((hi - saving[e]) / width)); };
+        vector<int> start(m + 1, 0);
+        for (int e = 0; e < m; e++) start[bucketOf(e) + 1]++;
+        for (int b = 0; b < m; b++) start[b + 1] += start[b];
+        vector<int> fill(start.begin(), start.end() - 1);
+        for (int e = 0; e < m; e++) order[fill[bucketOf(e)]++] = e;
+        for (int b = 0; b < m; b++) {
+            sort(order.begin() + start[b], order.begin() + start[b + 1],
+                 [&](int x, int y) { return saving[x] > saving[y]; });
+        }
+    }
+
+    //Routes as paths. link[i] holds up to 2 neighbours, otherEnd[i] is valid while i is a route end.
+    vector<array<int, 2>> link(n, {-1, -1});
+    vector<int> otherEnd(n);
+    for (int i = 0; i < n; i++) otherEnd[i] = i;
+    auto isEnd = [&](int i) { return link[i][1] < 0; };
+    auto join = [&](int i, int j) {
+        int ei = otherEnd[i], ej = otherEnd[j];
+        link[i][link[i][0] < 0 ? 0 : 1] = j;
+        link[j][link[j][0] < 0 ? 0 : 1] = i;
+        otherEnd[ei] = ej;
+        otherEnd[ej] = ei;
+    };
+
+    int routes = n - 1;
+    for (int e : order) {
+        int i = pairA[e], j = pairB[e];
+        if (isEnd(i) && isEnd(j) && otherEnd[i] != j) {
+            join(i, j);
+            routes--;
+        }
+    }
+
+    //Chain leftover routes: from the current end jump to the closest end of another route
+    if (routes > 1) {
+        vector<int> ends;   //one end per route
+        for (int i = 1; i < n; i++) {
+            if (isEnd(i) && otherEnd[i] >= i) ends.push_back(i);
+        }
+        int tail = otherEnd[ends.back()];
+        ends.pop_back();
+        while (!ends.empty()) {
+            double best = numeric_limits<double>::infinity();
+            int bi = -1;
+            bool flip = false;
+            for (int r = 0; r < (int)ends.size(); r++) {
+                int a = ends[r], b = otherEnd[a];
+                if (dist(tail, a) < best) { best = dist(tail, a); bi = r; flip = false; }
+                if (dist(tail, b) < best) { best = dist(tail, b); bi = r; flip = true; }
+            }
+            int a = ends[bi];
+            int b = otherEnd[a];
+            if (flip) swap(a, b);
+            ends[bi] = ends.back();
+            ends.pop_back();
+            join(tail, a);
+            tail = b;
+        }
+    }
+
+    //Walk the single path from one end, bracketed by the hub
+    vector<int> tour;
+    tour.reserve(n + 1);
+    tour.push_back(0);
+    int curr = -1;
+    for (int i = 1; i < n && curr < 0; i++) {
+        if (isEnd(i)) curr = i;
+    }
+    int from = -1;
+    while (curr >= 0) {
+        tour.push_back(curr);
+        int nxt = (link[curr][0] != from) ? link[curr][0] : link[curr][1];
+        from = curr;
+        curr = nxt;
+    }
     tour.push_back(0);
     return tour;
 }
 
+/*
+    Beam search version of nearest-neighbor (lookahead greedy).
+
+    Outline:
+        1) Keep the beamWidth best partial tours instead of just one
+        2) Each step, every partial tour proposes its `expand` nearest unvisited cities
+           (from its candidate list, or a row scan if all of those are visited)
+        3) Keep the beamWidth shortest of all proposals and repeat until every city is in
+        4) Close each tour back to 0 and return the shortest
+           (beam 0 is always kept as the plain greedy tour, so this never loses to greedy)
+
+    Tours are ranked by length minus a credit of (d1 + d2) / 2 for every city already visited
+    (d1, d2 = distances to its two nearest neighbours). Every complete tour gets the same total
+    credit, but partial tours that leave isolated cities behind score worse, which plain
+    length alone doesn't see (it happily strands the far-away cities, just like greedy).
+
+    beamWidth = 1, expand = 1 is plain nearest-neighbor. Partial tours are nodes in a shared
+    tree (city + parent), so keeping a tour costs one node per step instead of a copy.
+    Nodes are never freed: the tree holds at most 1 + (n-1) * beamWidth of them (8 bytes each),
+    reserved up front, which is small next to the n x n matrix this mode already needs.
+    The only per-tour state is a visited bitset. Each step a beam first copies its parent's
+    bitset and marks its new city, then makes its proposals. That is only O(expand) work per
+    beam (plus the copy), so with fewer than 4096 proposals a step (any normal beamWidth) the
+    beams run serially: n pool dispatches of tasks that small would cost more than they do.
+    Only wide beams go through one parallelFor per step.
+*/
+vector<int> beamSearchTour(const vector<vector<double>>& d, const NeighborLists& nbrs,
+                           int beamWidth, int expand, ThreadPool& pool) {
+    int n = (int)d.size();
+    int words = (n + 63) / 64;
+    beamWidth = max(1, beamWidth);
+    expand = max(1, expand);
+
+    struct Node { int city, parent; };
+    struct Beam { int node, parent; double len, score; };   //parent = its beam in the last step
+    struct Proposal { double score, len; int beam, city; };
+
+    vector<double> credit(n, 0.0);
+    for (int c = 0; c < n; c++) {
+        if (nbrs.k >= 2) credit[c] = 0.5 * (d[c][nbrs.of(c)[0]] + d[c][nbrs.of(c)[1]]);
+    }
+
+    vector<Node> nodes;   //the shared prefix tree, at most 1 + (n-1) * beamWidth nodes
+    nodes.reserve(1 + (size_t)(n - 1) * beamWidth);
+    nodes.push_back({0, -1});
+
+    vector<Beam> beams = {{0, -1, 0.0, 0.0}}, nextBeams;
+    vector<uint64_t> seen(words, 0), lastSeen;   //beam b's visited bits are seen[b*words ...]
+    seen[0] |= 1;
+
+    vector<Proposal> proposals((size_t)beamWidth * expand);
+    vector<int> proposed(beamWidth);
+    bool wide = (long long)beamWidth * expand >= 4096;   //worth spreading a step over the pool
+
+    for (int step = 1; step < n; step++) {
+        int B = (int)beams.size();
+
+        auto expandBeam = [&](int b, int) {
+            uint64_t* vis = &seen[(size_t)b * words];
+            int from = nodes[beams[b].node].city;
+            if (beams[b].parent >= 0) {
+                copy(lastSeen.begin() + (size_t)beams[b].parent * words,
+                     lastSeen.begin() + (size_t)(beams[b].parent + 1) * words, vis);
+                vis[from >> 6] |= 1ULL << (from & 63);
+            }
+
+            auto visited = [&](int c) { return (vis[c >> 6] >> (c & 63)) & 1; };
+            const double* row = d[from].data();
+            Proposal* out = &proposals[(size_t)b * expand];
+            int cnt = 0;
+            auto propose = [&](int c) {
+                return Proposal{beams[b].score + row[c] - credit[c], beams[b].len + row[c], b, c};
+            };
+
+            //Candidate list is sorted by distance, so the first unvisited ones are the nearest
+            for (int t = 0; t < nbrs.k && cnt < expand; t++) {
+                int c = nbrs.of(from)[t];
+                if (!visited(c)) out[cnt++] = propose(c);
+            }
+
+            //Whole neighbourhood used up: scan the row for the closest unvisited ones
+            if (cnt == 0) {
+                for (int c = 0; c < n; c++) {
+                    if (visited(c)) continue;
+                    Proposal p = propose(c);
+                    if (cnt < expand) {
+                        out[cnt++] = p;
+                    } else {
+                        int worst = 0;
+                        for (int q = 1; q < expand; q++) {
+                            if (out[q].len > out[worst].len) worst = q;
+                        }
+                        if (p.len < out[worst].len) out[worst] = p;
+                    }
+                }
+                sort(out, out + cnt, [](const Proposal& x, const Proposal& y) { return x.len < y.len; });
+            }
+            proposed[b] = cnt;
+        };
+        if (wide) {
+            pool.parallelFor(B, expandBeam);
+        } else {
+            for (int b = 0; b < B; b++) expandBeam(b, 0);
+        }
+
+        //Pool the proposals and keep the best beamWidth distinct ones
+        vector<Proposal> all;
+        all.reserve((size_t)B * expand);
+        for (int b = 0; b < B; b++) {
+            all.insert(all.end(), proposals.begin() + (size_t)b * expand,
+                       proposals.begin() + (size_t)b * expand + proposed[b]);
+        }
+        sort(all.begin(), all.end(), [](const Proposal& x, const Proposal& y) {
+            return x.score < y.score || (x.score == y.score && x.city < y.city);
+        });
+
+        //Beam 0 always takes its nearest city (see above)
+        vector<Proposal> keep = {proposals[0]};
+        auto sameEnd = [](const Proposal& x, const Proposal& y) { return x.score == y.score && x.city == y.city; };
+        for (size_t j = 0; j < all.size() && (int)keep.size() < beamWidth; j++) {
+            //Proposals ending at the same city with the same score count as one (they sit next
+            //to each other in all), and keep[0] already holds one of its own
+            if (sameEnd(all[j], keep[0]) || (j > 0 && sameEnd(all[j], all[j - 1]))) continue;
+            keep.push_back(all[j]);
+        }
+
+        //The kept beams' bitsets are filled in at the start of the next step
+        nextBeams.resize(keep.size());
+        for (size_t i = 0; i < keep.size(); i++) {
+            nodes.push_back({keep[i].city, beams[keep[i].beam].node});
+            nextBeams[i] = {(int)nodes.size() - 1, keep[i].beam, keep[i].len, keep[i].score};
+        }
+        swap(beams, nextBeams);
+        swap(seen, lastSeen);
+        seen.resize(keep.size() * words);
+    }
+
+    //Close every tour and take the shortest
+    int bestNode = beams[0].node;
+    double bestLen = numeric_limits<double>::infinity();
+    for (const Beam& bm : beams) {
+        double len = bm.len + d[nodes[bm.node].city][0];
+        if (len < bestLen) {
+            bestLen = len;
+            bestNode = bm.node;
+        }
+    }
+
+    vector<int> tour;
+    tour.reserve(n + 1);
+    tour.push_back(0);
+    for (int v = bestNode; v >= 0; v = nodes[v].parent) tour.push_back(nodes[v].city);
+    reverse(tour.begin(), tour.end());   //now 0 ... 0
+    return tour;
+}
+
+/*
+    GRASP: lots of randomized greedy tours (optionally 2-opt'd), keep the best.
+
+    Restarts are handed out to the pool's threads until maxRestarts have run or the
+    time budget (seconds, 0 = none) is used up. Restart i always draws from RNG stream i,
+    so with only a restart budget the result doesn't depend on the thread count.
+    Restart 0 is plain greedy and runs even when the budget is already gone, so there is
+    always a tour and GRASP never returns anything worse than nearest-neighbor.
+    The best tour is published through an atomic pointer (no lock): a thread that beats it
+    makes a new Result and swaps it in with compare-exchange.
+    With elite > 1 each thread also keeps its elite best tours, and the elite best of all of
+    them are merged by partition crossover (mergeTours) instead of just taking the best.
+*/
+vector<int> graspTour(const vector<Point>& pts, const NeighborLists& nbrs, int r,
+                      bool localSearch, int maxRestarts, double seconds, uint64_t seed, int elite,
+                      ThreadPool& pool, int& restartsRun) {
+    struct Result { double len; int restart; vector<int> tour; };
+
+    auto start = chrono::steady_clock::now();
+    auto outOfTime = [&] {
+        return seconds > 0 && chrono::duration<double>(chrono::steady_clock::now() - start).count() >= seconds;
+    };
+
+    atomic<const Result*> best{nullptr};
+    atomic<int> nextRestart{0}, finished{0};
+    vector<vector<unique_ptr<Result>>> published(pool.size());   //freed once everyone is done
+    vector<vector<Result>> elites(pool.size());                   //each sorted, shortest first
+    auto before = [](const Result& a, const Result& b) {
+        return a.len < b.len || (a.len == b.len && a.restart < b.restart);
+    };
+
+    pool.parallelFor(pool.size(), [&](int, int worker) {
+        int i;
+        //Restart 0 runs even if the time is already up, so there is always a tour to return
+        while ((i = nextRestart.fetch_add(1)) < maxRestarts && (i == 0 || !outOfTime())) {
+            CounterRng rng(seed, (uint64_t)i);
+            vector<int> tour = randomizedGreedyTour(pts, nbrs, i == 0 ? 1 : r, rng);
+            if (localSearch) {
+                TSP_PHASE("local_search");
+                twoOptImprove(tour, pts, nbrs);
+            }
+            double len = tourLength(tour, pts);
+            finished++;
+
+            vector<Result>& kept = elites[worker];
+            if (elite > 1 && ((int)kept.size() < elite || len < kept.back().len)) {
+                Result entry{len, i, tour};
+                kept.insert(upper_bound(kept.begin(), kept.end(), entry, before), move(entry));
+                if ((int)kept.size() > elite) kept.pop_back();
+            }
+
+            const Result* seen = best.load();
+            auto better = [&](const Result* cur) {
+                return !cur || len < cur->len || (len == cur->len && i < cur->restart);
+            };
+            if (!better(seen)) continue;
+
+            published[worker].push_back(unique_ptr<Result>(new Result{len, i, move(tour)}));
+            const Result* mine = published[worker].back().get();
+            while (better(seen) && !best.compare_exchange_weak(seen, mine)) {
+            }
+        }
+    });
+
+    restartsRun = finished;
+    if (elite <= 1) return best.load()->tour;
 
-//Computes total length of a closed tour.
-double tourLength(const vector<int>& tour, const vector<vector<double>>& d) {
-    double len = 0.0;
-    for (size_t i = 0; i + 1 < tour.size(); i++) {
-        len += d[tour[i]][tour[i + 1]];
+    vector<Result> all;
+    for (vector<Result>& kept : elites) {
+        for (Result& entry : kept) all.push_back(move(entry));
     }
-    return len;
+    sort(all.begin(), all.end(), before);
+    vector<vector<int>> tours;
+    for (int e = 0; e < min(elite, (int)all.size()); e++) tours.push_back(move(all[e].tour));
+    TSP_PHASE("merge");
+    return mergeTours(tours, pts);
+}
+
+/*
+    Ant colony optimization (MAX-MIN Ant System) over the k-nearest candidate edges.
+
+    Outline:
+        1) Pheromone lives only on candidate edges: tau[i * k + t] for city i's t-th neighbour,
+           all starting at tau_max = 1 / (rho * L) with L a nearest-neighbor tour's length
+        2) Each iteration the ants build tours on the pool's threads: from a random city, go to
+           an unvisited candidate with probability ~ tau * (1 / d)^4 (rouletteOver); when all
+           candidates are visited, go to the nearest unvisited one of their candidates (or of all
+           cities if none is left there). --ls 2-opts every ant
+        3) Each thread keeps its own best ant; the iteration's best is the min over threads
+        4) Evaporate everything by rho and deposit 1 / L on the iteration-best tour's edges
+           (the best-so-far tour's every 5th iteration), clamped to [tau_min, tau_max] with
+           tau_min = tau_max / (2n). Rows are split over the threads: each city's row is
+           written by one thread only, so the update needs no locks
+        5) Repeat until maxIterations or the time budget (seconds, 0 = none) runs out
+
+    Ant a of iteration it draws from RNG stream it * ants + a + 1, and ties go to the lower ant,
+    so the result doesn't depend on the thread count.
+*/
+vector<int> antColonyTour(const vector<Point>& pts, const NeighborLists& nbrs, int ants, int maxIterations,
+                          double seconds, bool localSearch, uint64_t seed, ThreadPool& pool, int& iterationsRun) {
+    const double rho = 0.2;   //evaporation per iteration
+    int n = (int)pts.size(), k = nbrs.k;
+    ants = max(1, ants);
+
+    auto start = chrono::steady_clock::now();
+    auto outOfTime = [&] {
+        return seconds > 0 && chrono::duration<double>(chrono::steady_clock::now() - start).count() >= seconds;
+    };
+
+    //Heuristic part of each candidate's weight (duplicate cities get a huge but finite one)
+    vector<double> eta((size_t)n * k), tau((size_t)n * k), weight((size_t)n * k);
+    for (int i = 0; i < n; i++) {
+        for (int t = 0; t < k; t++) {
+            double dist = distEuclid(pts[i], pts[nbrs.of(i)[t]]) + 1e-9;
+            eta[(size_t)i * k + t] = 1.0 / (dist * dist * dist * dist);   //beta = 4
+        }
+    }
+
+    CounterRng greedyRng(seed, 0);
+    vector<int> bestTour = randomizedGreedyTour(pts, nbrs, 1, greedyRng);
+    double bestLen = tourLength(bestTour, pts);
+    double tauMax = 1.0 / (rho * bestLen), tauMin = tauMax / (2.0 * n);
+    for (size_t e = 0; e < tau.size(); e++) {
+        tau[e] = tauMax;
+        weight[e] = tauMax * eta[e];
+    }
+
+    struct alignas(64) AntBest { double len; int ant; vector<int> tour; };
+    vector<AntBest> perWorker(pool.size());
+    vector<int> succ(n), pred(n);
+
+    int it = 0;
+    for (; it < maxIterations && !outOfTime(); it++) {
+        for (AntBest& b : perWorker) b.ant = -1;
+
+        pool.parallelFor(ants, [&](int a, int worker) {
+            CounterRng rng(seed, (uint64_t)it * ants + a + 1);
+            UnvisitedSet left(n);
+            vector<int> order;
+            vector<double> masked(k);
+            order.reserve(n + 1);
+
+            int curr = rng.below(n);
+            left.remove(curr);
+            order.push_back(curr);
+            for (int step = 1; step < n; step++) {
+                int next = rouletteOver(weight.data() + (size_t)curr * k, nbrs.of(curr), k, left.slots(),
+                                        rng.uniform(), masked.data());
+                if (next < 0) {
+                    //Nearest unvisited city among the candidates' candidates, else among all that's left
+                    double bestDist = numeric_limits<double>::infinity();
+                    for (int t = 0; t < k; t++) {
+                        const int* two = nbrs.of(nbrs.of(curr)[t]);
+                        for (int s = 0; s < k; s++) {
+                            if (!left.contains(two[s])) continue;
+                            double dist = distEuclid(pts[curr], pts[two[s]]);
+                            if (dist < bestDist) {
+                                bestDist = dist;
+                                next = two[s];
+                            }
+                        }
+                    }
+                    if (next < 0) {
+                        for (int i = 0; i < left.size(); i++) {
+                            double dist = distEuclid(pts[curr], pts[left[i]]);
+                            if (dist < bestDist) {
+                                bestDist = dist;
+                                next = left[i];
+                            }
+                        }
+                    }
+                }
+                curr = next;
+                left.remove(curr);
+                order.push_back(curr);
+            }
+
+            //Rotate to the 0 ... 0 format
+            rotate(order.begin(), find(order.begin(), order.end(), 0), order.end());
+            order.push_back(0);
+            if (localSearch) twoOptImprove(order, pts, nbrs);
+            double len = tourLength(order, pts);
+
+            AntBest& mine = perWorker[worker];
+            if (mine.ant < 0 || len < mine.len || (len == mine.len && a < mine.ant)) {
+                mine.len = len;
+                mine.ant = a;
+                mine.tour = move(order);
+            }
+        });
+
+        //Reduce the threads' bests to the iteration's best
+        int winner = -1;
+        for (int w = 0; w < (int)perWorker.size(); w++) {
+            const AntBest& b = perWorker[w];
+            if (b.ant < 0) continue;
+            if (winner < 0 || b.len < perWorker[winner].len ||
+                (b.len == perWorker[winner].len && b.ant < perWorker[winner].ant)) winner = w;
+        }
+        if (perWorker[winner].len < bestLen) {
+            bestLen = perWorker[winner].len;
+            bestTour = perWorker[winner].tour;
+            tauMax = 1.0 / (rho * bestLen);
+            tauMin = tauMax / (2.0 * n);
+        }
+
+        const vector<int>& deposit = (it % 5 == 4) ? bestTour : perWorker[winner].tour;
+        double amount = 1.0 / tourLength(deposit, pts);
+        for (int i = 0; i < n; i++) {
+            succ[deposit[i]] = deposit[i + 1];
+            pred[deposit[i + 1]] = deposit[i];
+        }
+
+        int chunks = pool.size();
+        pool.parallelFor(chunks, [&](int c, int) {
+            int lo = (int)((long long)n * c / chunks), hi = (int)((long long)n * (c + 1) / chunks);
+            for (int i = lo; i < hi; i++) {
+                for (int t = 0; t < k; t++) {
+                    size_t e = (size_t)i * k + t;
+                    int j = nbrs.of(i)[t];
+                    double v = tau[e] * (1.0 - rho);
+                    if (j == succ[i] || j == pred[i]) v += amount;
+                    tau[e] = min(tauMax, max(tauMin, v));
+                    weight[e] = tau[e] * eta[e];
+                }
+            }
+        });
+    }
+
+    iterationsRun = it;
+    return bestTour;
 }
 
 void writeSolutionSVG(const vector<Point>& points, const vector<int>& tour, float gridSize, const string& outname)
@@ -160,7 +968,7 @@ void writeSolutionSVG(const vector<Point>& points, const vector<int>& tour, floa
 
 int main(int argc, char* argv[]) {
     if (argc < 2) {
-        cout << "Usage: ./greedy <points_file.txt>\n";
+        cout << "Usage: ./greedy <points_file.txt> [--mode=nn|nearest|cheapest|farthest|savings|beam|grasp|aco] [--hull] [--sparse] [--k=10] [--beam=8 --expand=3] [--rcl=3 --restarts=100 --time=0 --seed=1 --ls] [--ants=25 --iterations=200] [--elite=1] [--improve=none|2opt|oropt|lk|anneal|tempering|eax [--parallel] [--budget=10]] [--merge=saved1.out,saved2.out] [--threads=N]\n";
         return 1;
     }
 
@@ -168,7 +976,12 @@ int main(int argc, char* argv[]) {
     vector<Point> points;
 
     //Load city coordinates
-    if (!loadPoints(filename, points)) {
+    bool loaded;
+    {
+        TSP_PHASE("load");
+        loaded = loadPoints(filename, points);
+    }
+    if (!loaded) {
         cerr << "Error: could not read points from " << filename << "\n";
         return 1;
     }
@@ -179,17 +992,144 @@ int main(int argc, char* argv[]) {
         return 0;
     }
 
-    //Build distance matrix once
-    vector<vector<double>> d = buildDistanceMatrix(points);
+    string mode = getArg(argc, argv, "mode", "nn");
+    bool hullStart = hasFlag(argc, argv, "hull");
+    bool sparse = hasFlag(argc, argv, "sparse");   //skip the n x n matrix, use candidate lists
+    int k = stoi(getArg(argc, argv, "k", "10"));
+    int threads = stoi(getArg(argc, argv, "threads", to_string(ThreadPool::defaultThreads())));
+    string improve = getArg(argc, argv, "improve", "none");
+    if (!knownImprovement(improve)) {
+        cerr << "Error: unknown improvement " << improve << "\n";
+        return 1;
+    }
+    vector<vector<int>> saved;   //tours from earlier runs to merge with (--merge=a.out,b.out)
+    string badTour;
+    if (!loadTours(getArg(argc, argv, "merge", ""), n, saved, badTour)) {
+        cerr << "Error: no tour over " << n << " cities in " << badTour << "\n";
+        return 1;
+    }
+
+    InsertRule rule = InsertRule::Nearest;
+    string label = "Greedy (Nearest-Neighbor)";
+    if (mode == "nearest") {
+        label = "Nearest Insertion";
+    } else if (mode == "cheapest") {
+        rule = InsertRule::Cheapest;
+        label = "Cheapest Insertion";
+    } else if (mode == "farthest") {
+        rule = InsertRule::Farthest;
+        label = "Farthest Insertion";
+    } else if (mode == "savings") {
+        label = "Clarke-Wright Savings";
+        sparse = true;   //savings only ever looks at candidate pairs
+    } else if (mode == "beam") {
+        label = "Beam Search Nearest-Neighbor";
+        sparse = false;   //falls back to matrix rows once the candidates run out
+    } else if (mode == "grasp") {
+        label = "GRASP Randomized Greedy";
+        sparse = true;   //tours come from the candidate lists, lengths from the coordinates
+    } else if (mode == "aco") {
+        label = "Ant Colony (MAX-MIN)";
+        sparse = true;   //pheromone and choices only on candidate edges
+    } else if (mode != "nn") {
+        cerr << "Error: unknown mode " << mode << "\n";
+        return 1;
+    }
+    if (mode == "nn") sparse = false;   //plain nearest-neighbor always scans the matrix rows
+    if ((mode == "nearest" || mode == "cheapest" || mode == "farthest") && hullStart) label += " (convex hull start)";
+
+    //Build distance matrix once (not needed in sparse mode)
+    vector<vector<double>> d;
+    if (!sparse) {
+        TSP_PHASE("distance_matrix");
+        d = buildDistanceMatrix(points);
+    }
 
-    //Run greedy
-    vector<int> tour = greedyNearestNeighborTour(d);
+    vector<int> tour;
+    {
+        TSP_PHASE("construct");
+        if (mode == "nn") {
+            //Run greedy
+            tour = greedyNearestNeighborTour(d);
+        } else if (mode == "beam") {
+            int beamWidth = stoi(getArg(argc, argv, "beam", "8"));
+            int expand = stoi(getArg(argc, argv, "expand", "3"));
+            NeighborLists nbrs = buildNeighborLists(points, max(k, expand));
+            ThreadPool pool(threads);
+            tour = beamSearchTour(d, nbrs, beamWidth, expand, pool);
+        } else if (mode == "grasp") {
+            int rcl = stoi(getArg(argc, argv, "rcl", "3"));   //pick among this many nearest
+            double seconds = stod(getArg(argc, argv, "time", "0"));
+            int restarts = stoi(getArg(argc, argv, "restarts", seconds > 0 ? "2000000000" : "100"));
+            if (restarts < 1) {
+                cerr << "Error: --restarts must be at least 1\n";
+                return 1;
+            }
+            uint64_t seed = stoull(getArg(argc, argv, "seed", "1"));
+            NeighborLists nbrs = buildNeighborLists(points, max(k, rcl));
+            ThreadPool pool(threads);
+            int restartsRun = 0;
+            int elite = stoi(getArg(argc, argv, "elite", "1"));   //best restarts to merge (1 = just keep the best)
+            tour = graspTour(points, nbrs, rcl, hasFlag(argc, argv, "ls"), restarts, seconds, seed, elite, pool,
+                             restartsRun);
+            cout << "GRASP restarts run: " << restartsRun << "\n";
+            TSP_COUNT("grasp_restarts", restartsRun);
+        } else if (mode == "aco") {
+            int ants = stoi(getArg(argc, argv, "ants", "25"));
+            double seconds = stod(getArg(argc, argv, "time", "0"));
+            int iterations = stoi(getArg(argc, argv, "iterations", seconds > 0 ? "2000000000" : "200"));
+            uint64_t seed = stoull(getArg(argc, argv, "seed", "1"));
+            NeighborLists nbrs = buildNeighborLists(points, k);
+            ThreadPool pool(threads);
+            int iterationsRun = 0;
+            tour = antColonyTour(points, nbrs, ants, iterations, seconds, hasFlag(argc, argv, "ls"), seed, pool, iterationsRun);
+            cout << "ACO iterations run: " << iterationsRun << "\n";
+            TSP_COUNT("aco_iterations", iterationsRun);
+        } else if (mode == "savings") {
+            NeighborLists nbrs = buildNeighborLists(points, k);
+            tour = savingsTour(points, nbrs);
+        } else if (sparse) {
+            NeighborLists nbrs = buildNeighborLists(points, k);
+            tour = insertionTour(points, nullptr, &nbrs, rule, hullStart);
+        } else {
+            tour = insertionTour(points, &d, nullptr, rule, hullStart);
+        }
+    }
 
-    double len = tourLength(tour, d);
+    //Optional local search on whatever the construction produced
+    double built = tourLength(tour, points);
+    if (improve != "none") {
+        ThreadPool pool(threads);
+        uint64_t seed = stoull(getArg(argc, argv, "seed", "1"));
+        improveTour(tour, points, improve, k, &pool, hasFlag(argc, argv, "parallel"), seed,
+                    stod(getArg(argc, argv, "budget", "10")));
+    }
+
+    //Merge with the saved tours by partition crossover (never longer than the best of them)
+    double unmerged = tourLength(tour, points);
+    if (!saved.empty()) {
+        TSP_PHASE("merge");
+        saved.push_back(tour);
+        for (const vector<int>& t : saved) unmerged = min(unmerged, tourLength(t, points));
+        tour = mergeTours(saved, points);
+    }
+
+    double len = sparse ? tourLength(tour, points) : tourLength(tour, d);
+
+    //Lower bound to judge the tour by (Delaunay MST, so no matrix even when d was built)
+    TourBound bound;
+    {
+        TSP_PHASE("lower_bound");
+        bound = tourLowerBound(points);
+    }
 
     //Results
     cout << fixed << setprecision(6);
-    cout << "Greedy (Nearest-Neighbor) Tour Length: " << len << "\n";
+    if (improve != "none") cout << "Constructed tour length (before " << improve << "): " << built << "\n";
+    if (!saved.empty()) cout << "Best of " << saved.size() << " tours before merging: " << unmerged << "\n";
+    cout << label << " Tour Length: " << len << "\n";
+    cout << "1-tree lower bound: " << bound.oneTree << " (MST " << bound.mst << ")\n";
+    cout << "Gap to lower bound: " << boundGap(len, bound.oneTree) << "\n";
     cout << "Tour order: ";
     for (size_t i = 0; i < tour.size(); i++) {
         cout << tour[i];
@@ -210,6 +1150,7 @@ int main(int argc, char* argv[]) {
     cin >> gridSize;
 
     writeSolutionSVG(points, tour, gridSize, base + "_greedySolution");
+    TSP_WRITE_STATS(base + "_greedyStats.json", "greedy-" + mode, filename, n, len);
 
     return 0;
 }
@@ -0,0 +1,548 @@
+/*
+    Author: Alex Keller, Ryan Leacock, Jimmy Finnegan, Graham Baker
+    Purpose: Pieces shared by the TSP solvers (points, saved tours, distances, candidate lists, heap,
+             threads, RNG, randomized greedy tours)
+*/
+
+#ifndef TSP_COMMON_H
+#define TSP_COMMON_H
+
+#include <algorithm>
+#include <atomic>
+#include <cctype>
+#include <cmath>
+#include <condition_variable>
+#include <cstdint>
+#include <fstream>
+#include <functional>
+#include <limits>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "TSP_Stats.h"
+
+
+//Point struct: Represents a city location in 2D space.
+struct Point {
+    double x, y;
+};
+
+
+//Computes distance between two cities.
+inline double distEuclid(const Point& a, const Point& b) {
+    TSP_COUNT_DIST(1);
+    double dx = a.x - b.x;
+    double dy = a.y - b.y;
+    return std::sqrt(dx * dx + dy * dy);
+}
+
+
+//Reads city coordinates from file. Returns true if successful, false if file can't open or empty.
+inline bool loadPoints(const std::string& filename, std::vector<Point>& points) {
+    std::ifstream in(filename);
+    if (!in.is_open()) return false;
+
+    Point p;
+    while (in >> p.x >> p.y) {   //keep reading x y pairs
+        points.push_back(p);
+    }
+
+    return !points.empty();
+}
+
+
+/*
+    Reads back a tour one of the solvers printed: the last "Tour order: 0 -> ... -> 0" line of a
+    saved output. Returns false if there is none or it isn't a closed tour over all n cities.
+*/
+inline bool loadTour(const std::string& filename, int n, std::vector<int>& tour) {
+    std::ifstream in(filename);
+    if (!in.is_open()) return false;
+
+    const std::string tag = "Tour order:";
+    std::string line, found;
+    while (std::getline(in, line)) {
+        if (line.compare(0, tag.size(), tag) == 0) found = line.substr(tag.size());
+    }
+
+    tour.clear();
+    for (size_t i = 0; i < found.size();) {
+        if (!std::isdigit((unsigned char)found[i])) {
+            i++;
+            continue;
+        }
+        int c = 0;
+        while (i < found.size() && std::isdigit((unsigned char)found[i])) c = c * 10 + (found[i++] - '0');
+        tour.push_back(c);
+    }
+
+    if ((int)tour.size() != n + 1 || tour[0] != 0 || tour[n] != 0) return false;
+    std::vector<char> seen(n, 0);
+    for (int i = 0; i < n; i++) {
+        if (tour[i] < 0 || tour[i] >= n || seen[tour[i]]) return false;
+        seen[tour[i]] = 1;
+    }
+    return true;
+}
+
+//loadTour for each file of a comma-separated list. On failure bad is the file that didn't read.
+inline bool loadTours(const std::string& files, int n, std::vector<std::vector<int>>& tours, std::string& bad) {
+    size_t from = 0;
+    while (from <= files.size()) {
+        size_t comma = std::min(files.find(',', from), files.size());
+        std::string name = files.substr(from, comma - from);
+        from = comma + 1;
+        if (name.empty()) continue;
+        tours.emplace_back();
+        if (!loadTour(name, n, tours.back())) {
+            bad = name;
+            return false;
+        }
+    }
+    return true;
+}
+
+
+//Precomputes all pairwise distances. This makes the loop faster.
+inline std::vector<std::vector<double>> buildDistanceMatrix(const std::vector<Point>& pts) {
+    int n = (int)pts.size();
+    std::vector<std::vector<double>> d(n, std::vector<double>(n, 0.0));
+
+    for (int i = 0; i < n; i++) {
+        for (int j = 0; j < n; j++) {
+            d[i][j] = distEuclid(pts[i], pts[j]);
+        }
+    }
+    return d;
+}
+
+
+//Computes total length of a closed tour.
+inline double tourLength(const std::vector<int>& tour, const std::vector<std::vector<double>>& d) {
+    double len = 0.0;
+    for (size_t i = 0; i + 1 < tour.size(); i++) {
+        len += d[tour[i]][tour[i + 1]];
+    }
+    return len;
+}
+
+//Same as above but straight from the coordinates, for runs too big for the matrix.
+inline double tourLength(const std::vector<int>& tour, const std::vector<Point>& pts) {
+    double len = 0.0;
+    for (size_t i = 0; i + 1 < tour.size(); i++) {
+        len += distEuclid(pts[tour[i]], pts[tour[i + 1]]);
+    }
+    return len;
+}
+
+
+/*
+    Command line options look like "--name=value" (or just "--name" for on/off switches).
+    getArg returns the value or def if the option wasn't given.
+*/
+inline std::string getArg(int argc, char* argv[], const std::string& name, const std::string& def) {
+    std::string prefix = "--" + name + "=";
+    for (int i = 1; i < argc; i++) {
+        std::string arg = argv[i];
+        if (arg.compare(0, prefix.size(), prefix) == 0) return arg.substr(prefix.size());
+    }
+    return def;
+}
+
+inline bool hasFlag(int argc, char* argv[], const std::string& name) {
+    std::string flag = "--" + name;
+    for (int i = 1; i < argc; i++) {
+        if (flag == argv[i]) return true;
+    }
+    return false;
+}
+
+
+/*
+    A fixed set of worker threads that are started once and reused.
+    parallelFor(count, fn) calls fn(i, worker) for every i in [0, count), spread over the
+    workers (the calling thread helps as worker 0), and returns when all of them are done.
+    worker is in [0, size()) so callers can keep per-thread scratch space.
+*/
+class ThreadPool {
+public:
+    explicit ThreadPool(int threads) {
+        int extra = std::max(1, threads) - 1;
+        for (int t = 1; t <= extra; t++) {
+            workers.emplace_back([this, t] { workerLoop(t); });
+        }
+    }
+
+    ~ThreadPool() {
+        {
+            std::lock_guard<std::mutex> lock(m);
+            stopping = true;
+            generation++;
+        }
+        wake.notify_all();
+        for (std::thread& w : workers) w.join();
+    }
+
+    int size() const { return (int)workers.size() + 1; }
+
+    void parallelFor(int count, const std::function<void(int, int)>& fn) {
+        if (workers.empty() || count <= 1) {
+            for (int i = 0; i < count; i++) fn(i, 0);
+            return;
+        }
+        {
+            std::lock_guard<std::mutex> lock(m);
+            job = &fn;
+            jobCount = count;
+            nextIndex = 0;
+            busy = (int)workers.size();
+            generation++;
+        }
+        wake.notify_all();
+        runJob(0);
+
+        std::unique_lock<std::mutex> lock(m);
+        done.wait(lock, [this] { return busy == 0; });
+        job = nullptr;
+    }
+
+    //Number of threads to use when the user didn't say
+    static int defaultThreads() {
+        unsigned hc = std::thread::hardware_concurrency();
+        return hc == 0 ? 1 : (int)hc;
+    }
+
+private:
+    std::vector<std::thread> workers;
+    std::mutex m;
+    std::condition_variable wake, done;
+    const std::function<void(int, int)>* job = nullptr;
+    int jobCount = 0;
+    std::atomic<int> nextIndex{0};
+    int busy = 0;
+    long long generation = 0;
+    bool stopping = false;
+
+    void runJob(int worker) {
+        int i;
+        while ((i = nextIndex.fetch_add(1)) < jobCount) (*job)(i, worker);
+    }
+
+    void workerLoop(int worker) {
+        long long seen = 0;
+        while (true) {
+            {
+                std::unique_lock<std::mutex> lock(m);
+                wake.wait(lock, [&] { return generation != seen; });
+                seen = generation;
+                if (stopping) return;
+            }
+            runJob(worker);
+            {
+                std::lock_guard<std::mutex> lock(m);
+                if (--busy == 0) done.notify_one();
+            }
+        }
+    }
+};
+
+
+/*
+    k-nearest candidate lists. Only O(nk) memory so this works when the n x n matrix doesn't fit.
+    ids[i*k + t] is the t-th closest city to i (closest first).
+*/
+struct NeighborLists {
+    int k = 0;
+    std::vector<int> ids;
+
+    const int* of(int i) const { return ids.data() + (size_t)i * k; }
+};
+
+/*
+    Outline:
+        1) Bucket the cities into a uniform grid with ~2 cities per cell
+        2) For each city search rings of cells around it, keeping the k best
+        3) Stop once the next ring is farther away than the current k-th best
+    Step 2 is split over the pool's threads when one is given.
+*/
+inline NeighborLists buildNeighborLists(const std::vector<Point>& pts, int k, ThreadPool* pool = nullptr) {
+    TSP_PHASE("neighbor_lists");
+    int n = (int)pts.size();
+    NeighborLists nl;
+    nl.k = std::max(0, std::min(k, n - 1));
+    nl.ids.assign((size_t)n * nl.k, -1);
+    if (nl.k == 0) return nl;
+
+    double minX = pts[0].x, maxX = pts[0].x, minY = pts[0].y, maxY = pts[0].y;
+    for (const Point& p : pts) {
+        minX = std::min(minX, p.x); maxX = std::max(maxX, p.x);
+        minY = std::min(minY, p.y); maxY = std::max(maxY, p.y);
+    }
+    double span = std::max(std::max(maxX - minX, maxY - minY), 1e-9);
+    int g = std::max(1, (int)std::sqrt(n / 2.0));
+    double cell = span / g;
+
+    auto cellOf = [&](double v, double lo) {
+        return std::min(g - 1, std::max(0, (int)((v - lo) / cell)));
+    };
+
+    //Counting sort of cities into cells (CSR layout). Coordinates are copied in cell order
+    //and queries run in cell order too, so neighbouring cells stay in cache.
+    std::vector<int> start(g * g + 1, 0), items(n);
+    for (const Point& p : pts) start[cellOf(p.y, minY) * g + cellOf(p.x, minX) + 1]++;
+    for (int c = 0; c < g * g; c++) start[c + 1] += start[c];
+    std::vector<int> fill(start.begin(), start.end() - 1);
+    for (int i = 0; i < n; i++) items[fill[cellOf(pts[i].y, minY) * g + cellOf(pts[i].x, minX)]++] = i;
+    std::vector<double> xs(n), ys(n);
+    for (int s = 0; s < n; s++) {
+        xs[s] = pts[items[s]].x;
+        ys[s] = pts[items[s]].y;
+    }
+
+    auto queryRange = [&](int from, int to) {
+        //The k best so far, sorted by squared distance (k is small, so insertion beats a heap)
+        std::vector<double> bestD(nl.k + 1);
+        std::vector<int> bestId(nl.k + 1);
+        for (int q = from; q < to; q++) {
+            double px = xs[q], py = ys[q];
+            int cx = cellOf(px, minX), cy = cellOf(py, minY);
+            int cnt = 0;
+
+            for (int r = 0; r < g; r++) {
+                //Every city in ring r is at least (r-1)*cell away
+                double ringGap = (r - 1) * cell;
+                if (cnt == nl.k && r > 1 && ringGap * ringGap > bestD[cnt - 1]) break;
+
+                for (int y = cy - r; y <= cy + r; y++) {
+                    if (y < 0 || y >= g) continue;
+                    bool edgeRow = (y == cy - r || y == cy + r);
+                    for (int x = cx - r; x <= cx + r; x += (edgeRow ? 1 : 2 * r)) {
+                        if (x >= 0 && x < g) {
+                            TSP_COUNT_DIST(start[y * g + x + 1] - start[y * g + x]);
+                            for (int s = start[y * g + x]; s < start[y * g + x + 1]; s++) {
+                                double dx = xs[s] - px, dy = ys[s] - py;
+                                double d2 = dx * dx + dy * dy;
+                                if (s == q || (cnt == nl.k && d2 >= bestD[cnt - 1])) continue;
+                                int p = (cnt < nl.k) ? cnt++ : cnt - 1;
+                                while (p > 0 && bestD[p - 1] > d2) {
+                                    bestD[p] = bestD[p - 1];
+                                    bestId[p] = bestId[p - 1];
+                                    p--;
+                                }
+                                bestD[p] = d2;
+                                bestId[p] = items[s];
+                            }
+                        }
+                        if (r == 0) break;
+                    }
+                }
+            }
+
+            std::copy(bestId.begin(), bestId.begin() + cnt, nl.ids.begin() + (size_t)items[q] * nl.k);
+        }
+    };
+
+    if (pool && pool->size() > 1) {
+        int chunks = pool->size() * 8;
+        int chunkSize = (n + chunks - 1) / chunks;
+        pool->parallelFor(chunks, [&](int c, int) { queryRange(std::min(n, c * chunkSize), std::min(n, (c + 1) * chunkSize)); });
+    } else {
+        queryRange(0, n);
+    }
+    return nl;
+}
+
+
+/*
+    Binary min-heap over item ids 0..n-1 that remembers where each id sits,
+    so a key can be changed in O(log n) without searching for it.
+*/
+class IndexedHeap {
+public:
+    explicit IndexedHeap(int n) : pos(n, -1), key(n, 0.0) {}
+
+    bool empty() const { return heap.empty(); }
+    bool contains(int id) const { return pos[id] >= 0; }
+    int top() const { return heap[0]; }
+    double keyOf(int id) const { return key[id]; }
+
+    //Inserts id or changes its key (either direction)
+    void set(int id, double k) {
+        if (pos[id] < 0) {
+            pos[id] = (int)heap.size();
+            heap.push_back(id);
+            key[id] = k;
+            siftUp(pos[id]);
+        } else if (k < key[id]) {
+            key[id] = k;
+            siftUp(pos[id]);
+        } else {
+            key[id] = k;
+            siftDown(pos[id]);
+        }
+    }
+
+    int pop() {
+        int id = heap[0];
+        remove(id);
+        return id;
+    }
+
+    void remove(int id) {
+        int i = pos[id];
+        int last = heap.back();
+        heap.pop_back();
+        pos[id] = -1;
+        if (last == id) return;
+        heap[i] = last;
+        pos[last] = i;
+        siftUp(i);
+        siftDown(pos[last]);
+    }
+
+private:
+    std::vector<int> heap, pos;
+    std::vector<double> key;
+
+    void siftUp(int i) {
+        while (i > 0) {
+            int p = (i - 1) / 2;
+            if (key[heap[p]] <= key[heap[i]]) break;
+            swapAt(i, p);
+            i = p;
+        }
+    }
+
+    void siftDown(int i) {
+        int n = (int)heap.size();
+        while (true) {
+            int l = 2 * i + 1, r = l + 1, m = i;
+            if (l < n && key[heap[l]] < key[heap[m]]) m = l;
+            if (r < n && key[heap[r]] < key[heap[m]]) m = r;
+            if (m == i) break;
+            swapAt(i, m);
+            i = m;
+        }
+    }
+
+    void swapAt(int a, int b) {
+        std::swap(heap[a], heap[b]);
+        pos[heap[a]] = a;
+        pos[heap[b]] = b;
+    }
+};
+
+
+/*
+    Counter-based random numbers: the i-th number of a stream is just a hash of (seed, stream, i),
+    so any thread can produce any stream and runs repeat exactly for the same seed.
+    The mixing is the SplitMix64 finalizer.
+*/
+struct CounterRng {
+    uint64_t key, counter = 0;
+
+    CounterRng(uint64_t seed, uint64_t stream) : key(mix(seed ^ mix(stream + 0x9E3779B97F4A7C15ULL))) {}
+
+    uint64_t next() { return mix(key + 0x9E3779B97F4A7C15ULL * ++counter); }
+
+    //Uniform int in [0, n)
+    int below(int n) { return (int)(((next() >> 32) * (uint64_t)n) >> 32); }
+
+    //Uniform double in [0, 1)
+    double uniform() { return (next() >> 11) * (1.0 / 9007199254740992.0); }
+
+    static uint64_t mix(uint64_t z) {
+        z = (z ^ (z >> 30)) * 0xBF58476D1CE4E5B9ULL;
+        z = (z ^ (z >> 27)) * 0x94D049BB133111EBULL;
+        return z ^ (z >> 31);
+    }
+};
+
+/*
+    The cities a construction hasn't visited yet, packed at the front of an array: testing,
+    removing one and scanning what's left are all O(1) per city, and a scan only ever touches
+    unvisited cities.
+*/
+class UnvisitedSet {
+public:
+    explicit UnvisitedSet(int n) : rest(n), where(n), remaining(n) {
+        for (int j = 0; j < n; j++) rest[j] = where[j] = j;
+    }
+
+    bool contains(int c) const { return where[c] >= 0; }
+    int size() const { return remaining; }
+    int operator[](int i) const { return rest[i]; }
+
+    //The unvisited cities themselves, packed in [0, size())
+    const int* data() const { return rest.data(); }
+
+    //Each city's slot in the packed array, -1 once visited (for gathering many contains() at once)
+    const int* slots() const { return where.data(); }
+
+    void remove(int c) {
+        int last = rest[--remaining];
+        rest[where[c]] = last;
+        where[last] = where[c];
+        where[c] = -1;
+    }
+
+private:
+    std::vector<int> rest, where;
+    int remaining;
+};
+
+/*
+    Randomized nearest-neighbor (one GRASP construction): each step picks uniformly among the
+    r nearest unvisited cities (r = 1 is plain greedy). Candidates come from the sorted
+    candidate list; once those are all visited the unvisited cities are scanned.
+*/
+inline std::vector<int> randomizedGreedyTour(const std::vector<Point>& pts, const NeighborLists& nbrs,
+                                             int r, CounterRng& rng) {
+    int n = (int)pts.size();
+    r = std::max(1, r);
+    UnvisitedSet left(n);
+
+    std::vector<int> tour, pick(r);
+    std::vector<double> pickDist(r);
+    tour.reserve(n + 1);
+    int curr = 0;
+    left.remove(curr);
+    tour.push_back(curr);
+
+    for (int step = 1; step < n; step++) {
+        int cnt = 0;
+        for (int t = 0; t < nbrs.k && cnt < r; t++) {
+            int c = nbrs.of(curr)[t];
+            if (left.contains(c)) pick[cnt++] = c;
+        }
+
+        if (cnt == 0) {
+            //r closest of what's left (r is small, so keep them in a tiny sorted list)
+            for (int i = 0; i < left.size(); i++) {
+                int c = left[i];
+                double dc = distEuclid(pts[curr], pts[c]);
+                if (cnt == r && dc >= pickDist[cnt - 1]) continue;
+                int p = (cnt < r) ? cnt++ : cnt - 1;
+                while (p > 0 && pickDist[p - 1] > dc) {
+                    pick[p] = pick[p - 1];
+                    pickDist[p] = pickDist[p - 1];
+                    p--;
+                }
+                pick[p] = c;
+                pickDist[p] = dc;
+            }
+        }
+
+        curr = pick[rng.below(cnt)];
+        left.remove(curr);
+        tour.push_back(curr);
+    }
+
+    tour.push_back(0);
+    return tour;
+}
+
+
+#endif
@@ -0,0 +1,735 @@
+/*
+    Author: Alex Keller, Ryan Leacock, Jimmy Finnegan, Graham Baker
+    Purpose: Genetic algorithm with edge assembly crossover (EAX) over a population of tours, and
+             tour merging by partition crossover (GPX)
+*/
+
+#ifndef TSP_GENETIC_H
+#define TSP_GENETIC_H
+
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <cstdint>
+#include <unordered_map>
+#include <utility>
+#include <vector>
+
+#include "TSP_Common.h"
+
+
+//A tour stored as each city's two neighbours, link[2c] and link[2c + 1] (the form EAX edits)
+struct LinkedTour {
+    std::vector<int> link;
+    double length = 0;
+};
+
+inline LinkedTour toLinked(const std::vector<int>& closed, const std::vector<Point>& pts) {
+    int n = (int)closed.size() - 1;
+    LinkedTour t;
+    t.link.resize(2 * n);
+    for (int i = 0; i < n; i++) {
+        int c = closed[i];
+        t.link[2 * c] = closed[i == 0 ? n - 1 : i - 1];
+        t.link[2 * c + 1] = closed[i + 1];
+    }
+    t.length = tourLength(closed, pts);
+    return t;
+}
+
+//Back to 0 ... 0
+inline std::vector<int> toClosed(const LinkedTour& t) {
+    int n = (int)t.link.size() / 2;
+    std::vector<int> closed(n + 1);
+    int prev = -1, c = 0;
+    for (int i = 0; i < n; i++) {
+        closed[i] = c;
+        int next = (t.link[2 * c] != prev) ? t.link[2 * c] : t.link[2 * c + 1];
+        prev = c;
+        c = next;
+    }
+    closed[n] = 0;
+    return closed;
+}
+
+//The undirected edge (a,b) as one number
+inline uint64_t edgeKey(int a, int b) {
+    if (a > b) std::swap(a, b);
+    return ((uint64_t)a << 32) | (uint32_t)b;
+}
+
+//How many tours of the population use each edge
+typedef std::unordered_map<uint64_t, int> EdgeCounts;
+
+//What turns a parent into its child: the edges it loses and gains
+struct ChildDiff {
+    std::vector<std::pair<int, int>> removed, added;
+    double gain = 0;    //parent length - child length
+    double score = 0;   //> 0 only for a child worth keeping (see EAXCrossover::bestChild)
+};
+
+//Applies a ChildDiff to its parent
+inline void applyDiff(LinkedTour& t, const ChildDiff& diff) {
+    auto drop = [&](int u, int v) { t.link[2 * u + (t.link[2 * u] == v ? 0 : 1)] = -1; };
+    auto join = [&](int u, int v) { t.link[2 * u + (t.link[2 * u] == -1 ? 0 : 1)] = v; };
+    for (const auto& e : diff.removed) {
+        drop(e.first, e.second);
+        drop(e.second, e.first);
+    }
+    for (const auto& e : diff.added) {
+        join(e.first, e.second);
+        join(e.second, e.first);
+    }
+    t.length -= diff.gain;
+}
+
+
+/*
+    EAX crossover of two parents A and B, keeping the best child.
+
+    Outline:
+        1) AB-cycles: walk the edges that are in only one of A and B, alternating an A edge and
+           a B edge (picked at random where there are two). Whenever the walk comes back, after
+           a B edge, to a city it left by an A edge, the loop in between is an AB-cycle: cut it
+           off and carry on. Every city has as many A-only as B-only edges, so this uses them all
+        2) One child per AB-cycle (EAX-1AB, up to maxKids of them, in random order): A minus the
+           cycle's A edges plus its B edges. That leaves A broken into subtours
+        3) Merge the subtours, smallest first: remove one edge (u,u') of the smallest and one
+           edge (v,v') of another, where v is among u's k nearest, and join them with (u,v),
+           (u',v') or (u,v'),(u',v), whichever 2-exchange costs least
+        4) Score the child by its gain over A against the edge entropy the population would
+           lose by taking it (see bestChild) and put A back (only the touched cities change)
+
+    Each thread owns one of these and all its scratch arrays, sized once for n cities, so
+    making children never goes back to the allocator.
+*/
+class EAXCrossover {
+public:
+    EAXCrossover(const std::vector<Point>& pts, const NeighborLists& nbrs)
+        : pts(pts), nbrs(nbrs), n((int)pts.size()), link(2 * n), restA(2 * n), restB(2 * n), countA(n), countB(n),
+          evenAt(n, -1), label(n), touchedAt(n, 0) {}
+
+    /*
+        Best child of A and B, as the diff to A. A child is only worth taking if it is shorter;
+        among those the score is gain / (entropy lost), or gain / 1e-9 when it doesn't lower
+        the population's edge entropy. So a child that keeps rare edges alive beats a slightly
+        shorter one that makes the population more alike, and the search doesn't collapse
+        onto one tour too early. score stays 0 if no child is shorter. best is overwritten
+        (its arrays are reused, so keep one per pair across generations).
+    */
+    void bestChild(const LinkedTour& A, const LinkedTour& B, const EdgeCounts& counts, int popSize,
+                   int maxKids, CounterRng& rng, long long& kids, ChildDiff& best) {
+        best.removed.clear();
+        best.added.clear();
+        best.gain = best.score = 0;
+        findABCycles(A, B, rng);
+        int cycleCount = (int)cycleStart.size() - 1;
+        if (cycleCount == 0) return;
+
+        order.resize(cycleCount);
+        for (int i = 0; i < cycleCount; i++) order[i] = i;
+        for (int i = cycleCount - 1; i > 0; i--) std::swap(order[i], order[rng.below(i + 1)]);
+
+        std::copy(A.link.begin(), A.link.end(), link.begin());
+        for (int c = 0; c < std::min(maxKids, cycleCount); c++) {
+            makeChild(order[c]);
+            kids++;
+            collectDiff(A, diff);
+            if (diff.gain > 1e-9) {
+                double lost = -entropyChange(diff, counts, popSize);
+                double score = diff.gain / (lost > 1e-12 ? lost : 1e-9);
+                if (score > best.score) {
+                    best.removed.assign(diff.removed.begin(), diff.removed.end());
+                    best.added.assign(diff.added.begin(), diff.added.end());
+                    best.gain = diff.gain;
+                    best.score = score;
+                }
+            }
+            for (int u : touched) {
+                link[2 * u] = A.link[2 * u];
+                link[2 * u + 1] = A.link[2 * u + 1];
+            }
+        }
+    }
+
+    //Change in the population's edge entropy -sum p log p (p = share of tours using the edge)
+    //if A were replaced by A + diff
+    static double entropyChange(const ChildDiff& diff, const EdgeCounts& counts, int popSize) {
+        auto h = [&](int f) { return f > 0 ? -(f / (double)popSize) * std::log(f / (double)popSize) : 0.0; };
+        auto countOf = [&](int a, int b) {
+            auto it = counts.find(edgeKey(a, b));
+            return it == counts.end() ? 0 : it->second;
+        };
+        double change = 0;
+        for (const auto& e : diff.removed) {
+            int f = countOf(e.first, e.second);
+            change += h(f - 1) - h(f);
+        }
+        for (const auto& e : diff.added) {
+            int f = countOf(e.first, e.second);
+            change += h(f + 1) - h(f);
+        }
+        return change;
+    }
+
+private:
+    const std::vector<Point>& pts;
+    const NeighborLists& nbrs;
+    int n;
+
+    std::vector<int> link;                 //the child; A again between children
+    std::vector<int> restA, restB;         //A-only / B-only edges still unused at each city (2 slots)
+    std::vector<int> countA, countB;
+    std::vector<int> path, evenAt, open;   //AB-cycle walk; evenAt = city's even index on the path
+    std::vector<int> cycles, cycleStart;   //all AB-cycles, back to back
+    std::vector<int> order;
+    std::vector<int> label, subStart, subSize, members;
+    std::vector<int> touched, touchedAt;
+    int stamp = 0;
+    ChildDiff diff;                        //the child being scored
+
+    double dist(int a, int b) const { return distEuclid(pts[a], pts[b]); }
+
+    //Takes a random unused edge out of the two slots at u and the matching one at its other end
+    static int takeEdge(std::vector<int>& rest, std::vector<int>& count, int u, CounterRng& rng) {
+        int i = (count[u] == 2) ? (int)(rng.next() & 1) : 0;
+        int w = rest[2 * u + i];
+        rest[2 * u + i] = rest[2 * u + --count[u]];
+        int j = (rest[2 * w] == u) ? 0 : 1;
+        rest[2 * w + j] = rest[2 * w + --count[w]];
+        return w;
+    }
+
+    void findABCycles(const LinkedTour& A, const LinkedTour& B, CounterRng& rng) {
+        open.clear();
+        for (int v = 0; v < n; v++) {
+            countA[v] = countB[v] = 0;
+            for (int s = 0; s < 2; s++) {
+                int a = A.link[2 * v + s], b = B.link[2 * v + s];
+                if (a != B.link[2 * v] && a != B.link[2 * v + 1]) restA[2 * v + countA[v]++] = a;
+                if (b != A.link[2 * v] && b != A.link[2 * v + 1]) restB[2 * v + countB[v]++] = b;
+            }
+            if (countA[v] > 0) open.push_back(v);
+        }
+
+        cycles.clear();
+        cycleStart.assign(1, 0);
+        path.clear();
+        while (true) {
+            if (path.empty()) {
+                //Random start among the cities with A-only edges left (drop used-up ones as they turn up)
+                int s = -1;
+                while (s < 0 && !open.empty()) {
+                    int pick = rng.below((int)open.size());
+                    std::swap(open[pick], open.back());
+                    if (countA[open.back()] > 0) s = open.back();
+                    else open.pop_back();
+                }
+                if (s < 0) break;
+                path.push_back(s);
+                evenAt[s] = 0;
+            }
+
+            int cur = path.back();
+            bool even = (path.size() % 2 == 1);   //index of cur is even: leave by an A edge
+            int w = even ? takeEdge(restA, countA, cur, rng) : takeEdge(restB, countB, cur, rng);
+            path.push_back(w);
+            if (even) continue;
+
+            int at = (int)path.size() - 1;
+            if (evenAt[w] < 0) {
+                evenAt[w] = at;
+                continue;
+            }
+
+            //Closed a loop path[j] ... path[at] == path[j]: that's an AB-cycle
+            int j = evenAt[w];
+            cycles.insert(cycles.end(), path.begin() + j, path.end() - 1);
+            cycleStart.push_back((int)cycles.size());
+            for (int t = j + 2; t < at; t += 2) evenAt[path[t]] = -1;
+            path.resize(j + 1);
+            if (path.size() == 1 && countA[path[0]] == 0) {
+                evenAt[path[0]] = -1;
+                path.clear();
+            }
+        }
+    }
+
+    void touch(int u) {
+        if (touchedAt[u] != stamp) {
+            touchedAt[u] = stamp;
+            touched.push_back(u);
+        }
+    }
+
+    void dropEdge(int u, int v) {
+        link[2 * u + (link[2 * u] == v ? 0 : 1)] = -1;
+        link[2 * v + (link[2 * v] == u ? 0 : 1)] = -1;
+        touch(u);
+        touch(v);
+    }
+
+    void addEdge(int u, int v) {
+        link[2 * u + (link[2 * u] == -1 ? 0 : 1)] = v;
+        link[2 * v + (link[2 * v] == -1 ? 0 : 1)] = u;
+    }
+
+    int nextOf(int c, int prev) const { return link[2 * c] != prev ? link[2 * c] : link[2 * c + 1]; }
+
+    void makeChild(int cycle) {
+        stamp++;
+        touched.clear();
+        const int* c = cycles.data() + cycleStart[cycle];
+        int len = cycleStart[cycle + 1] - cycleStart[cycle];
+        for (int i = 0; i < len; i += 2) dropEdge(c[i], c[i + 1]);
+        for (int i = 1; i < len; i += 2) addEdge(c[i], c[(i + 1) % len]);
+        mergeSubtours();
+    }
+
+    void mergeSubtours() {
+        //Label the subtours
+        std::fill(label.begin(), label.end(), -1);
+        subStart.clear();
+        subSize.clear();
+        for (int v = 0; v < n; v++) {
+            if (label[v] >= 0) continue;
+            int id = (int)subStart.size(), size = 0;
+            for (int prev = -1, c = v;;) {
+                label[c] = id;
+                size++;
+                int next = nextOf(c, prev);
+                prev = c;
+                c = next;
+                if (c == v) break;
+            }
+            subStart.push_back(v);
+            subSize.push_back(size);
+        }
+
+        for (int left = (int)subStart.size(); left > 1; left--) {
+            int S = -1;
+            for (int s = 0; s < (int)subSize.size(); s++) {
+                if (subSize[s] > 0 && (S < 0 || subSize[s] < subSize[S])) S = s;
+            }
+            members.clear();
+            for (int prev = -1, c = subStart[S];;) {
+                members.push_back(c);
+                int next = nextOf(c, prev);
+                prev = c;
+                c = next;
+                if (c == subStart[S]) break;
+            }
+
+            //Cheapest 2-exchange into another subtour over the candidate lists
+            double bestCost = 0;
+            int bu = -1, bu2 = -1, bv = -1, bv2 = -1;
+            auto consider = [&](int u, int v) {
+                for (int su = 0; su < 2; su++) {
+                    int u2 = link[2 * u + su];
+                    double cut = dist(u, u2);
+                    for (int sv = 0; sv < 2; sv++) {
+                        int v2 = link[2 * v + sv];
+                        double base = cut + dist(v, v2);
+                        double straight = dist(u, v) + dist(u2, v2) - base;
+                        double cross = dist(u, v2) + dist(u2, v) - base;
+                        if (bu < 0 || straight < bestCost) {
+                            bestCost = straight;
+                            bu = u; bu2 = u2; bv = v; bv2 = v2;
+                        }
+                        if (cross < bestCost) {
+                            bestCost = cross;
+                            bu = u; bu2 = u2; bv = v2; bv2 = v;
+                        }
+                    }
+                }
+            };
+            for (int u : members) {
+                for (int s = 0; s < nbrs.k; s++) {
+                    int v = nbrs.of(u)[s];
+                    if (label[v] != S) consider(u, v);
+                }
+            }
+            if (bu < 0) {
+                //All candidates inside S: look at every city outside it from a few of S's
+                for (int i = 0; i < (int)members.size() && i < 8; i++) {
+                    for (int v = 0; v < n; v++) {
+                        if (label[v] != S) consider(members[i], v);
+                    }
+                }
+            }
+
+            //(u,u2),(v,v2) -> (u,v),(u2,v2)
+            dropEdge(bu, bu2);
+            dropEdge(bv, bv2);
+            addEdge(bu, bv);
+            addEdge(bu2, bv2);
+            int T = label[bv];
+            for (int c : members) label[c] = T;
+            subSize[T] += subSize[S];
+            subSize[S] = 0;
+        }
+    }
+
+    void collectDiff(const LinkedTour& A, ChildDiff& diff) {
+        diff.removed.clear();
+        diff.added.clear();
+        diff.gain = 0;
+        for (int u : touched) {
+            for (int s = 0; s < 2; s++) {
+                int w = link[2 * u + s];
+                if (u < w && w != A.link[2 * u] && w != A.link[2 * u + 1]) {
+                    diff.added.push_back({u, w});
+                    diff.gain -= dist(u, w);
+                }
+                int a = A.link[2 * u + s];
+                if (u < a && a != link[2 * u] && a != link[2 * u + 1]) {
+                    diff.removed.push_back({u, a});
+                    diff.gain += dist(u, a);
+                }
+            }
+        }
+    }
+};
+
+
+/*
+    Evolves a population of tours with EAX for up to seconds. Returns the index of the best.
+
+    Outline:
+        1) Count how many tours use each edge (for the entropy in the selection)
+        2) Each generation shuffles the population into a ring; every tour is parent A once,
+           with the next tour in the ring as B. The pool makes all the children at once, each
+           thread with its own EAXCrossover, reading the population and the edge counts only
+        3) Then, one by one, each A is replaced by its best child (if it has one) and the edge
+           counts are updated
+        4) Stop when the budget is used up or 10 generations in a row replace nothing
+
+    Generation g draws its ring from RNG stream g * (size + 1) and pair i from the stream after
+    it, so what a generation does depends on the seed only, not on the threads.
+*/
+inline int eaxEvolve(std::vector<LinkedTour>& pop, const std::vector<Point>& pts, const NeighborLists& nbrs,
+                     double seconds, uint64_t seed, ThreadPool& pool) {
+    int size = (int)pop.size();
+    EdgeCounts counts;
+    for (const LinkedTour& t : pop) {
+        for (int v = 0; v < (int)t.link.size() / 2; v++) {
+            for (int s = 0; s < 2; s++) {
+                if (v < t.link[2 * v + s]) counts[edgeKey(v, t.link[2 * v + s])]++;
+            }
+        }
+    }
+
+    std::vector<EAXCrossover> crossers;
+    for (int w = 0; w < pool.size(); w++) crossers.emplace_back(pts, nbrs);
+    std::vector<long long> kids(pool.size(), 0);
+
+    const int maxKids = 30, quietLimit = 10;
+    auto start = std::chrono::steady_clock::now();
+    std::vector<int> ring(size);
+    std::vector<ChildDiff> children(size);
+    long long generations = 0, replaced = 0;
+    for (int quiet = 0; quiet < quietLimit;) {
+        uint64_t stream = (uint64_t)generations * (size + 1);
+        CounterRng shuffle(seed, stream);
+        for (int i = 0; i < size; i++) ring[i] = i;
+        for (int i = size - 1; i > 0; i--) std::swap(ring[i], ring[shuffle.below(i + 1)]);
+
+        pool.parallelFor(size, [&](int i, int worker) {
+            CounterRng rng(seed, stream + 1 + i);
+            crossers[worker].bestChild(pop[ring[i]], pop[ring[(i + 1) % size]], counts, size, maxKids, rng,
+                                       kids[worker], children[i]);
+        });
+
+        int took = 0;
+        for (int i = 0; i < size; i++) {
+            const ChildDiff& child = children[i];
+            if (child.score <= 0) continue;
+            for (const auto& e : child.removed) {
+                auto it = counts.find(edgeKey(e.first, e.second));
+                if (--it->second == 0) counts.erase(it);
+            }
+            for (const auto& e : child.added) counts[edgeKey(e.first, e.second)]++;
+            applyDiff(pop[ring[i]], child);
+            took++;
+        }
+        replaced += took;
+        generations++;
+        quiet = took ? 0 : quiet + 1;
+        if (std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count() >= seconds) break;
+    }
+
+    long long made = 0;
+    for (long long k : kids) made += k;
+    TSP_COUNT("eax_generations", generations);
+    TSP_COUNT("eax_children", made);
+    TSP_COUNT("eax_replacements", replaced);
+
+    int best = 0;
+    for (int i = 1; i < size; i++) {
+        if (pop[i].length < pop[best].length) best = i;
+    }
+    return best;
+}
+
+
+//One partition crossover of the closed tours a and b; see partitionCrossover
+inline std::vector<int> gpxChild(const std::vector<int>& a, const std::vector<int>& b, const std::vector<Point>& pts,
+                                 int& components) {
+    int n = (int)a.size() - 1;
+    components = 0;
+
+    //Each city's two neighbours in a closed tour (over n cities) or in a ring (over all m)
+    auto linksOf = [](const std::vector<int>& order, int size) {
+        std::vector<int> link(2 * size);
+        for (int i = 0; i < size; i++) {
+            link[2 * order[i]] = order[i == 0 ? size - 1 : i - 1];
+            link[2 * order[i] + 1] = order[i + 1 == size ? 0 : i + 1];
+        }
+        return link;
+    };
+    auto has = [](const std::vector<int>& link, int v, int x) { return link[2 * v] == x || link[2 * v + 1] == x; };
+
+    //1) Ghosts for the cities where the tours share no edge
+    std::vector<int> linkA = linksOf(a, n), linkB = linksOf(b, n);
+    std::vector<int> orig(n), ghost(n, -1);
+    for (int c = 0; c < n; c++) orig[c] = c;
+    for (int c = 0; c < n; c++) {
+        if (has(linkB, c, linkA[2 * c]) || has(linkB, c, linkA[2 * c + 1])) continue;
+        ghost[c] = (int)orig.size();
+        orig.push_back(c);
+    }
+    int m = (int)orig.size();
+    auto expand = [&](const std::vector<int>& t) {
+        std::vector<int> ring;
+        ring.reserve(m);
+        for (int i = 0; i < n; i++) {
+            ring.push_back(t[i]);
+            if (ghost[t[i]] >= 0) ring.push_back(ghost[t[i]]);
+        }
+        return ring;
+    };
+    std::vector<int> ringA = expand(a), ringB = expand(b);
+    linkA = linksOf(ringA, m);
+    linkB = linksOf(ringB, m);
+
+    //2) Components of the edges in only one tour
+    std::vector<int> parent(m);
+    for (int v = 0; v < m; v++) parent[v] = v;
+    auto root = [&](int v) {
+        while (parent[v] != v) v = parent[v] = parent[parent[v]];
+        return v;
+    };
+    std::vector<char> differs(m, 0);
+    for (int v = 0; v < m; v++) {
+        for (int s = 0; s < 2; s++) {
+            int x = linkA[2 * v + s], y = linkB[2 * v + s];
+            if (!has(linkB, v, x)) {
+                differs[v] = 1;
+                parent[root(v)] = root(x);
+            }
+            if (!has(linkA, v, y)) {
+                differs[v] = 1;
+                parent[root(v)] = root(y);
+            }
+        }
+    }
+    std::vector<int> comp(m, -1);
+    for (int v = 0; v < m; v++) {
+        if (differs[v]) comp[v] = root(v);
+    }
+
+    //3) Each tour's runs in tour order: (component or -1 for a shared path, first place, length)
+    struct Run { int c, at, len; };
+    auto runsOf = [&](const std::vector<int>& ring) {
+        std::vector<Run> runs;
+        int from = -1;
+        for (int i = 0; i < m && from < 0; i++) {
+            if (comp[ring[i]] != comp[ring[i == 0 ? m - 1 : i - 1]]) from = i;
+        }
+        if (from < 0) return runs;   //one component holding every city (or the tours are the same)
+        for (int j = 0; j < m;) {
+            int c = comp[ring[(from + j) % m]], len = 1;
+            while (j + len < m && comp[ring[(from + j + len) % m]] == c) len++;
+            runs.push_back({c, (from + j) % m, len});
+            j += len;
+        }
+        return runs;
+    };
+    //The runs through components as (component, their two ends), sorted
+    auto endsOf = [&](const std::vector<int>& ring, const std::vector<Run>& runs) {
+        std::vector<std::pair<int, uint64_t>> ends;
+        for (const Run& r : runs) {
+            if (r.c >= 0) ends.push_back({r.c, edgeKey(ring[r.at], ring[(r.at + r.len - 1) % m])});
+        }
+        std::sort(ends.begin(), ends.end());
+        return ends;
+    };
+
+    const int fuseRounds = 8;
+    std::vector<char> feasible(m, 0), fused(m, 0);
+    for (int round = 0;; round++) {
+        std::vector<Run> runsA = runsOf(ringA);
+        std::vector<std::pair<int, uint64_t>> endsA = endsOf(ringA, runsA), endsB = endsOf(ringB, runsOf(ringB));
+        std::fill(feasible.begin(), feasible.end(), 0);
+        if (runsA.empty()) {
+            for (int v = 0; v < m; v++) {
+                if (comp[v] >= 0) feasible[comp[v]] = 1;
+            }
+        }
+        for (size_t i = 0, j = 0; i < endsA.size();) {
+            int c = endsA[i].first;
+            size_t endA = i, endB;
+            while (endA < endsA.size() && endsA[endA].first == c) endA++;
+            while (j < endsB.size() && endsB[j].first < c) j++;
+            for (endB = j; endB < endsB.size() && endsB[endB].first == c; endB++) {
+            }
+            feasible[c] = (endA - i == endB - j) && std::equal(endsA.begin() + i, endsA.begin() + endA, endsB.begin() + j);
+            i = endA;
+            j = endB;
+        }
+        if (round == fuseRounds) break;
+
+        //4) Fusion (as in GPX2), then look again. First take the shared path between two runs of
+        //the same infeasible component into it (a 2-opt move's reversed stretch, say); only when
+        //there is none, join each infeasible component to the next one along A together with
+        //the shared path between them (B takes those paths too)
+        bool any = false;
+        std::fill(fused.begin(), fused.end(), 0);
+        for (int pass = 0; pass < 2 && !any; pass++) {
+            for (size_t r = 0; r < runsA.size(); r++) {
+                int x = runsA[r].c;
+                size_t y = r + 1;
+                if (y < runsA.size() && runsA[y].c < 0) y++;
+                if (x < 0 || y >= runsA.size()) continue;
+                int z = runsA[y].c;
+                if (feasible[x] || feasible[z]) continue;
+                if (pass == 0 ? (z != x || y == r + 1) : (z == x || fused[x] || fused[z])) continue;
+                int into = root(x);
+                for (size_t p = r + 1; p < y; p++) {
+                    for (int i = 0; i < runsA[p].len; i++) parent[ringA[(runsA[p].at + i) % m]] = into;
+                }
+                if (z != x) {
+                    parent[z] = into;
+                    fused[x] = fused[z] = 1;
+                }
+                any = true;
+            }
+        }
+        if (!any) break;
+        for (int v = 0; v < m; v++) {
+            if (comp[v] >= 0 || root(v) != v) comp[v] = root(v);
+        }
+    }
+
+    //5) B's paths where they are shorter (the margin keeps two equally long sets of paths,
+    //summed in a different order, from both looking shorter)
+    std::vector<double> insideA(m, 0.0), insideB(m, 0.0);
+    for (int v = 0; v < m; v++) {
+        if (comp[v] < 0) continue;
+        for (int s = 0; s < 2; s++) {
+            int x = linkA[2 * v + s], y = linkB[2 * v + s];
+            if (v < x && comp[x] == comp[v]) insideA[comp[v]] += distEuclid(pts[orig[v]], pts[orig[x]]);
+            if (v < y && comp[y] == comp[v]) insideB[comp[v]] += distEuclid(pts[orig[v]], pts[orig[y]]);
+        }
+    }
+    std::vector<char> takeB(m, 0);
+    for (int v = 0; v < m; v++) {
+        if (comp[v] != v || !feasible[v] || insideB[v] >= insideA[v] * (1 - 1e-12)) continue;
+        takeB[v] = 1;
+        components++;
+    }
+    if (components == 0) return a;
+
+    std::vector<int> link(2 * m);
+    for (int v = 0; v < m; v++) {
+        const std::vector<int>& from = (comp[v] >= 0 && takeB[comp[v]]) ? linkB : linkA;
+        link[2 * v] = from[2 * v];
+        link[2 * v + 1] = from[2 * v + 1];
+    }
+    std::vector<int> child;
+    child.reserve(n + 1);
+    for (int i = 0, prev = -1, v = 0; i < m; i++) {
+        if (v < n) child.push_back(v);
+        int next = (link[2 * v] != prev) ? link[2 * v] : link[2 * v + 1];
+        prev = v;
+        v = next;
+    }
+    child.push_back(0);
+    return child;
+}
+
+/*
+    Partition crossover (GPX, with GPX2's ghost cities) of two tours. The child is never longer
+    than A (so pass the shorter one as A).
+
+    Outline:
+        1) Split each city where A and B share no edge into the city and a ghost, joined by an
+           edge of length 0 that both tours use (they enter the city and leave from the ghost).
+           This cuts the union graph into many more pieces
+        2) Drop the edges A and B share; what is left falls apart into connected components
+           (union-find over the edges in only one tour)
+        3) Cut each tour into runs through each component. A component is feasible if B's runs
+           join the same pairs of cities as A's: inside it A and B are then two sets of paths
+           between the same ends over the same cities, and either set fits
+        4) Grow the infeasible components by the shared paths next to them (fusion, up to
+           fuseRounds times) and check them again
+        5) Take B's paths in every feasible component where they are shorter and A's everywhere
+           else, then drop the ghosts again
+
+    Which way B runs decides where its ghosts go, so both ways are tried and the shorter child
+    wins. O(n log n) per round. components (if given) gets how many components came from B.
+*/
+inline LinkedTour partitionCrossover(const LinkedTour& A, const LinkedTour& B, const std::vector<Point>& pts,
+                                     int* components = nullptr) {
+    int n = (int)A.link.size() / 2;
+    if (components) *components = 0;
+    if (n < 4) return A;
+
+    std::vector<int> a = toClosed(A), b = toClosed(B);
+    int forward = 0, backward = 0;
+    LinkedTour child = toLinked(gpxChild(a, b, pts, forward), pts);
+    std::reverse(b.begin(), b.end());
+    LinkedTour other = toLinked(gpxChild(a, b, pts, backward), pts);
+    if (other.length < child.length) {
+        child = std::move(other);
+        forward = backward;
+    }
+
+    if (forward == 0 || child.length >= A.length) return A;
+    if (components) *components = forward;
+    return child;
+}
+
+/*
+    Merges tours (closed, 0 ... 0) from different runs into one at least as short as the best:
+    starting from the best, partition crossover with each of the others in turn (shortest
+    first), and go round again while that still shortens it. Near-linear per pass.
+    Expects at least one tour; with none there is nothing to merge and it returns an empty tour.
+*/
+inline std::vector<int> mergeTours(const std::vector<std::vector<int>>& tours, const std::vector<Point>& pts) {
+    if (tours.empty()) return {};
+
+    std::vector<LinkedTour> linked;
+    for (const std::vector<int>& t : tours) linked.push_back(toLinked(t, pts));
+    std::vector<int> order(linked.size());
+    for (int i = 0; i < (int)order.size(); i++) order[i] = i;
+    std::stable_sort(order.begin(), order.end(), [&](int a, int b) { return linked[a].length < linked[b].length; });
+
+    LinkedTour best = linked[order[0]];
+    long long taken = 0;
+    for (bool better = true; better;) {
+        better = false;
+        for (int i = 1; i < (int)order.size(); i++) {
+            int got = 0;
+            LinkedTour child = partitionCrossover(best, linked[order[i]], pts, &got);
+            if (got == 0) continue;
+            taken += got;
+            best = std::move(child);
+            better = true;
+        }
+    }
+    TSP_COUNT("merge_components", taken);
+    return toClosed(best);
+}
+
+#endif
@@ -0,0 +1,776 @@
+/*
+    Author: Alex Keller, Ryan Leacock, Jimmy Finnegan, Graham Baker
+    Purpose: Improvement passes that run on any closed tour the solvers produce
+*/
+
+#ifndef TSP_LOCALSEARCH_H
+#define TSP_LOCALSEARCH_H
+
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <memory>
+#include <string>
+#include <vector>
+
+#include "TSP_Common.h"
+#include "TSP_Genetic.h"
+#include "TSP_Tour.h"
+
+
+/*
+    FIFO of cities whose neighbourhood may still hold an improving move (the "don't-look bits"
+    are simply the cities not in here). Each city is queued at most once at a time.
+*/
+class ActiveQueue {
+public:
+    //Starts with every city queued, in tour order
+    template <class Tour>
+    explicit ActiveQueue(const Tour& t) : ring(t.size()), queued(t.size(), 1), count(t.size()) {
+        int c = 0;
+        for (int i = 0; i < t.size(); i++, c = t.next(c)) ring[i] = c;
+    }
+
+    bool empty() const { return count == 0; }
+
+    int pop() {
+        int c = ring[head];
+        if (++head == (int)ring.size()) head = 0;
+        count--;
+        queued[c] = 0;
+        return c;
+    }
+
+    void push(int c) {
+        if (queued[c]) return;
+        queued[c] = 1;
+        int tail = head + count;
+        if (tail >= (int)ring.size()) tail -= (int)ring.size();
+        ring[tail] = c;
+        count++;
+    }
+
+private:
+    std::vector<int> ring;
+    std::vector<char> queued;
+    int head = 0, count;
+};
+
+
+//Replaces tour edges (a,b),(c,d) by (a,c),(b,d), where b follows a and d follows c in the same direction
+template <class Tour>
+void twoOptMove(Tour& t, int a, int b, int c, int d) {
+    (void)d;
+    if (t.next(a) == b) t.reverse(b, c);
+    else t.reverse(c, b);
+}
+
+/*
+    Looks for one improving 2-opt move around city a and applies it.
+
+    For both of a's tour neighbours b (succ, then pred) look at the candidates c of a that are
+    closer than b; d is c's neighbour on the same side. Replacing (a,b),(c,d) by (a,c),(b,d)
+    wins if it's shorter. The four endpoints go back in the queue.
+*/
+template <class Tour>
+bool tryTwoOpt(Tour& t, int a, const std::vector<Point>& pts, const NeighborLists& nbrs, ActiveQueue& active) {
+    auto dist = [&](int u, int v) { return distEuclid(pts[u], pts[v]); };
+
+    for (int side = 0; side < 2; side++) {
+        int b = (side == 0) ? t.next(a) : t.prev(a);
+        if (t.fixed(a, b)) continue;
+        double ab = dist(a, b);
+
+        for (int s = 0; s < nbrs.k; s++) {
+            int c = nbrs.of(a)[s];
+            double ac = dist(a, c);
+            if (ac >= ab) break;   //candidates are sorted, nothing closer left
+
+            int d = (side == 0) ? t.next(c) : t.prev(c);
+            if (c == b || d == a || t.fixed(c, d)) continue;
+
+            if (ac + dist(b, d) < ab + dist(c, d) - 1e-10) {
+                twoOptMove(t, a, b, c, d);
+                active.push(a);
+                active.push(b);
+                active.push(c);
+                active.push(d);
+                return true;
+            }
+        }
+    }
+    return false;
+}
+
+//Moves the forward segment f..l (p before it, x after it) into the forward edge u -> v, the same
+//way round if keep is set and turned around otherwise, as three 2-opt moves
+template <class Tour>
+void orOptMove(Tour& t, int p, int f, int l, int x, int u, int v, bool keep) {
+    //p f..l x ... u v  ->  p x ... u [f..l or l..f] v
+    //If v is p, read the tour backwards so the moves below never meet that case
+    if (v == p) {
+        std::swap(p, x);
+        std::swap(f, l);
+        std::swap(u, v);
+    }
+    twoOptMove(t, p, f, u, v);   //p u ... x l..f v
+    twoOptMove(t, p, u, x, l);   //p x ... u l..f v
+    if (keep) twoOptMove(t, u, l, f, v);   //p x ... u f..l v
+}
+
+/*
+    Looks for one improving Or-opt move around city a and applies it: a segment of 1-3 cities
+    with a at one end is cut out and put back, either way round, between two other neighbours.
+
+    Outline:
+        1) Segment f..l (forward) with p before it and x after it. Cutting it out and joining
+           p-x saves g = d(p,f) + d(l,x) - d(p,x)
+        2) For each candidate c of a closer than g, try both tour edges at c as the new home
+           (u,v): the cost is d(u,v) - min(d(u,f) + d(l,v), d(u,l) + d(f,v)), O(1) per try
+        3) Apply the first win as three 2-opt moves and queue the six endpoints
+*/
+template <class Tour>
+bool tryOrOpt(Tour& t, int a, const std::vector<Point>& pts, const NeighborLists& nbrs, ActiveQueue& active) {
+    auto dist = [&](int u, int v) { return distEuclid(pts[u], pts[v]); };
+    int n = t.size();
+
+    for (int len = 1; len <= 3 && len + 3 <= n; len++) {
+        for (int end = 0; end < (len == 1 ? 1 : 2); end++) {
+            //a is the segment's first city (end 0) or its last (end 1)
+            int seg[3];
+            seg[0] = a;
+            for (int i = 1; i < len; i++) seg[i] = (end == 0) ? t.next(seg[i - 1]) : t.prev(seg[i - 1]);
+            int f = (end == 0) ? seg[0] : seg[len - 1];
+            int l = (end == 0) ? seg[len - 1] : seg[0];
+            int p = t.prev(f), x = t.next(l);
+            double g = dist(p, f) + dist(l, x) - dist(p, x);
+            if (g <= 1e-10 || t.fixed(p, f) || t.fixed(l, x)) continue;
+
+            auto inSegment = [&](int c) { return c == seg[0] || (len > 1 && c == seg[1]) || (len > 2 && c == seg[2]); };
+
+            for (int s = 0; s < nbrs.k; s++) {
+                int c = nbrs.of(a)[s];
+                if (dist(a, c) >= g) break;
+                if (inSegment(c)) continue;
+
+                for (int side = 0; side < 2; side++) {
+                    //New home is the forward edge u -> v, one end of it being c
+                    int u = (side == 0) ? c : t.prev(c);
+                    int v = (side == 0) ? t.next(c) : c;
+                    if (u == l || v == f || t.fixed(u, v)) continue;   //(u,v) can't be one of the cut edges
+
+                    double keep = dist(u, f) + dist(l, v), flip = dist(u, l) + dist(f, v);
+                    double added = std::min(keep, flip);
+                    if (added - dist(u, v) >= g - 1e-10) continue;
+
+                    orOptMove(t, p, f, l, x, u, v, keep < flip);
+                    for (int w : {p, f, l, x, u, v}) active.push(w);
+                    return true;
+                }
+            }
+        }
+    }
+    return false;
+}
+
+/*
+    2-opt over candidate lists with don't-look bits.
+
+    Outline:
+        1) Pop an active city and try an improving 2-opt move around it (tryTwoOpt)
+        2) A move re-activates its endpoints; a city that finds nothing drops out of the queue
+        3) Done when the queue is empty (every city is 2-opt optimal over its candidates)
+
+    Moves reverse a path, and the tour flips whichever side is shorter. Returns the moves made.
+*/
+template <class Tour>
+long long twoOpt(Tour& t, const std::vector<Point>& pts, const NeighborLists& nbrs) {
+    if (t.size() < 4) return 0;
+    ActiveQueue active(t);
+    long long moves = 0;
+
+    while (!active.empty()) {
+        int a = active.pop();
+        if (tryTwoOpt(t, a, pts, nbrs, active)) moves++;
+    }
+
+    TSP_COUNT("two_opt_moves", moves);
+    return moves;
+}
+
+//2-opt and Or-opt together: each active city tries a 2-opt move first, then an Or-opt move
+template <class Tour>
+long long twoOptOrOpt(Tour& t, const std::vector<Point>& pts, const NeighborLists& nbrs) {
+    if (t.size() < 5) return twoOpt(t, pts, nbrs);
+    ActiveQueue active(t);
+    long long twoMoves = 0, orMoves = 0;
+
+    while (!active.empty()) {
+        int a = active.pop();
+        if (tryTwoOpt(t, a, pts, nbrs, active)) twoMoves++;
+        else if (tryOrOpt(t, a, pts, nbrs, active)) orMoves++;
+    }
+
+    TSP_COUNT("two_opt_moves", twoMoves);
+    TSP_COUNT("or_opt_moves", orMoves);
+    return twoMoves + orMoves;
+}
+
+/*
+    Lin-Kernighan style variable-depth search from one city t1, built out of 2-opt moves.
+
+    Outline:
+        1) Break (t1,t2) for a tour neighbour t2. g is the gain so far with the path still open
+        2) Pick t3 among t2's candidates with g - d(t2,t3) > 0, and t4 next to t3 so that the
+           2-opt move (t1,t2),(t4,t3) -> (t2,t3),(t1,t4) is legal; apply it. The tour is whole
+           again, shorter by g - d(t2,t3) + d(t3,t4) - d(t4,t1)
+        3) Carry on from t2 = t4 (the edge (t1,t4) is the next one broken), best lookahead
+           g - d(t2,t3) + d(t3,t4) first, up to maxDepth steps. Edges added in this chain are
+           never broken again
+        4) Keep the prefix of the chain with the best total gain, undo the rest
+
+    Only the first two levels try alternatives (5 and 3 of them); deeper it follows the best.
+*/
+template <class Tour>
+class LinKernighan {
+public:
+    static const int maxDepth = 50;
+
+    LinKernighan(Tour& t, const std::vector<Point>& pts, const NeighborLists& nbrs)
+        : t(t), pts(pts), nbrs(nbrs) {}
+
+    //Tries an improving chain from t1; if found it stays applied and its cities are queued
+    bool improve(int t1, ActiveQueue& active) {
+        this->t1 = t1;
+        for (int side = 0; side < 2; side++) {
+            int t2 = (side == 0) ? t.next(t1) : t.prev(t1);
+            if (t.fixed(t1, t2)) continue;
+            applied.clear();
+            added.clear();
+            bestGain = 1e-10;
+            bestSteps = 0;
+            search(0, t2, dist(t1, t2));
+
+            if (bestSteps > 0) {
+                while (applied.size() > bestSteps) undoLast();
+                for (const Step& st : applied) {
+                    active.push(t1);
+                    active.push(st.t2);
+                    active.push(st.t3);
+                    active.push(st.t4);
+                }
+                return true;
+            }
+        }
+        return false;
+    }
+
+private:
+    struct Step {
+        int t2, t3, t4;
+    };
+    struct Choice {
+        double lookahead;
+        int t3, t4;
+    };
+
+    Tour& t;
+    const std::vector<Point>& pts;
+    const NeighborLists& nbrs;
+    int t1 = 0;
+    std::vector<Step> applied;
+    std::vector<std::pair<int, int>> added;
+    double bestGain = 0;
+    size_t bestSteps = 0;
+
+    double dist(int a, int b) const { return distEuclid(pts[a], pts[b]); }
+
+    bool wasAdded(int a, int b) const {
+        for (auto& e : added) {
+            if ((e.first == a && e.second == b) || (e.first == b && e.second == a)) return true;
+        }
+        return false;
+    }
+
+    void undoLast() {
+        Step st = applied.back();
+        applied.pop_back();
+        added.pop_back();
+        twoOptMove(t, t1, st.t4, st.t2, st.t3);   //(t1,t4),(t2,t3) -> (t1,t2),(t4,t3)
+    }
+
+    void search(int depth, int t2, double g) {
+        bool succ = (t.next(t1) == t2);
+        Choice choices[64];
+        int count = 0;
+        for (int s = 0; s < nbrs.k && count < 64; s++) {
+            int t3 = nbrs.of(t2)[s];
+            double g1 = g - dist(t2, t3);
+            if (g1 <= 1e-10) break;   //candidates are sorted, the rest only cost more
+            if (t3 == t1 || t3 == t2) continue;
+            int t4 = succ ? t.prev(t3) : t.next(t3);
+            if (t4 == t2 || wasAdded(t4, t3) || t.fixed(t4, t3)) continue;
+            choices[count++] = {g1 + dist(t3, t4), t3, t4};
+        }
+        std::sort(choices, choices + count, [](const Choice& a, const Choice& b) { return a.lookahead > b.lookahead; });
+
+        int breadth = (depth == 0) ? 5 : (depth == 1) ? 3 : 1;
+        for (int i = 0; i < std::min(breadth, count); i++) {
+            int t3 = choices[i].t3, t4 = choices[i].t4;
+            twoOptMove(t, t1, t2, t4, t3);
+            applied.push_back({t2, t3, t4});
+            added.push_back({t2, t3});
+
+            double gOpen = choices[i].lookahead;
+            double closed = gOpen - dist(t4, t1);
+            if (closed > bestGain) {
+                bestGain = closed;
+                bestSteps = applied.size();
+            }
+            if (depth + 1 < maxDepth) search(depth + 1, t4, gOpen);
+            if (bestSteps > 0) return;   //found one: the caller trims the chain to its best prefix
+
+            undoLast();
+        }
+    }
+};
+
+//Lin-Kernighan from every active city, with Or-opt for what the chains miss
+template <class Tour>
+long long linKernighan(Tour& t, const std::vector<Point>& pts, const NeighborLists& nbrs) {
+    if (t.size() < 5) return twoOpt(t, pts, nbrs);
+    ActiveQueue active(t);
+    LinKernighan<Tour> lk(t, pts, nbrs);
+    long long lkMoves = 0, orMoves = 0;
+
+    while (!active.empty()) {
+        int a = active.pop();
+        if (lk.improve(a, active)) lkMoves++;
+        else if (tryOrOpt(t, a, pts, nbrs, active)) orMoves++;
+    }
+
+    TSP_COUNT("lk_moves", lkMoves);
+    TSP_COUNT("or_opt_moves", orMoves);
+    return lkMoves + orMoves;
+}
+
+//2-opt on the closed format the solvers print (0 ... 0), which it stays in
+inline void twoOptImprove(std::vector<int>& tour, const std::vector<Point>& pts, const NeighborLists& nbrs) {
+    if ((int)tour.size() - 1 < 4) return;
+    ArrayTour t(tour);
+    twoOpt(t, pts, nbrs);
+    tour = t.closed();
+}
+
+//From this many cities on, the O(sqrt n) reversals of the two-level list beat the array's O(n)
+const int twoLevelFrom = 10000;
+
+/*
+    Random 2-opt and Or-opt moves for simulated annealing, one proposal per step.
+
+    A step picks a random city a and, at random, one of its k nearest c, then either the 2-opt
+    move that joins a to c (on a's succ or pred side) or moving the 1-3 cities starting at a
+    next to c (whichever way round is shorter). The length change takes six distances at most,
+    so a proposal is O(1); only an accepted move touches the tour. One 64-bit draw supplies
+    every random choice of a step.
+*/
+template <class Tour>
+class Annealer {
+public:
+    Annealer(Tour& t, const std::vector<Point>& pts, const NeighborLists& nbrs, uint64_t seed, uint64_t stream)
+        : t(t), pts(pts), nbrs(nbrs), rng(seed, stream) {}
+
+    long long accepted = 0;
+
+    //Proposes a move and takes it with the Metropolis rule at temperature T (always if it is
+    //shorter, with probability exp(-delta / T) if not). Returns the change in length (0 if not taken).
+    double step(double T) {
+        if (!propose()) return 0;
+        if (m.delta > 0 && (m.delta >= 30 * T || rng.uniform() >= std::exp(-m.delta / T))) return 0;
+        if (m.orOpt) orOptMove(t, m.p, m.f, m.l, m.x, m.u, m.v, m.keep);
+        else twoOptMove(t, m.p, m.f, m.u, m.v);
+        accepted++;
+        return m.delta;
+    }
+
+    //Temperature at which a share rate of the uphill moves among samples proposals would be
+    //taken (none of them is): bisection on the mean of exp(-delta / T) over them
+    double temperatureFor(double rate, int samples) {
+        std::vector<double> up;
+        for (int i = 0; i < samples; i++) {
+            if (propose() && m.delta > 0) up.push_back(m.delta);
+        }
+        if (up.empty()) return 0.0;
+        double lo = 0, hi = *std::max_element(up.begin(), up.end());
+        for (int it = 0; it < 50; it++) {
+            double T = 0.5 * (lo + hi), taken = 0;
+            for (double delta : up) taken += std::exp(-delta / T);
+            if (taken < rate * up.size()) lo = T;
+            else hi = T;
+        }
+        return hi;
+    }
+
+private:
+    //2-opt: (p,f),(u,v) -> (p,u),(f,v). Or-opt: f..l from between p and x into u -> v
+    struct Move {
+        bool orOpt, keep;
+        int p, f, l, x, u, v;
+        double delta;
+    };
+
+    Tour& t;
+    const std::vector<Point>& pts;
+    const NeighborLists& nbrs;
+    CounterRng rng;
+    Move m;
+
+    double dist(int a, int b) const { return distEuclid(pts[a], pts[b]); }
+
+    bool propose() {
+        uint64_t r = rng.next();
+        int a = (int)(((r >> 32) * (uint64_t)t.size()) >> 32);
+        int c = nbrs.of(a)[((r & 0xFFFF) * (uint64_t)nbrs.k) >> 16];
+        bool succ = (r >> 16) & 1;
+
+        if ((r >> 17) & 1) {
+            int b = succ ? t.next(a) : t.prev(a);
+            int d = succ ? t.next(c) : t.prev(c);
+            if (c == b || d == a) return false;
+            m.orOpt = false;
+            m.p = a; m.f = b; m.u = c; m.v = d;
+            m.delta = dist(a, c) + dist(b, d) - dist(a, b) - dist(c, d);
+            return true;
+        }
+
+        int len = 1 + (int)((((r >> 18) & 0xFFFF) * 3) >> 16);
+        int l = a;
+        for (int i = 1; i < len; i++) {
+            if (c == l) return false;
+            l = t.next(l);
+        }
+        if (c == l) return false;
+        int p = t.prev(a), x = t.next(l);
+        int u = succ ? c : t.prev(c);
+        int v = succ ? t.next(c) : c;
+        if (u == l || v == a) return false;   //(u,v) is one of the cut edges
+
+        double keep = dist(u, a) + dist(l, v), flip = dist(u, l) + dist(a, v);
+        m.orOpt = true;
+        m.keep = keep <= flip;
+        m.p = p; m.f = a; m.l = l; m.x = x; m.u = u; m.v = v;
+        m.delta = std::min(keep, flip) - dist(u, v) - (dist(p, a) + dist(l, x) - dist(p, x));
+        return true;
+    }
+};
+
+/*
+    Simulated annealing for a wall-clock budget (seconds). Returns the moves taken.
+
+    Outline:
+        1) Sample proposals on the start tour (a 2-opt/Or-opt optimum) and set T0 so that 3% of
+           the uphill ones would be taken. A share rather than a mean uphill step, so a few long
+           jumps (between clusters, say) don't make it too hot to keep any of the start tour
+        2) Run the Annealer in blocks of steps; after each block T = T0 / 1000^(share of the
+           budget used), so the cooling is stretched over whatever the budget and the machine
+           allow and always ends cold
+        3) The caller quenches the result with 2-opt + Or-opt (see annealTour)
+*/
+template <class Tour>
+long long anneal(Tour& t, const std::vector<Point>& pts, const NeighborLists& nbrs, double seconds, uint64_t seed) {
+    if (t.size() < 8 || seconds <= 0) return 0;
+    Annealer<Tour> sa(t, pts, nbrs, seed, 0);
+    const double T0 = sa.temperatureFor(0.03, 10000), endRatio = 1e-3;
+    if (T0 <= 0) return 0;
+
+    auto start = std::chrono::steady_clock::now();
+    double T = T0;
+    long long steps = 0;
+    while (true) {
+        for (int i = 0; i < 4096; i++) sa.step(T);
+        steps += 4096;
+        double used = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count() / seconds;
+        if (used >= 1) break;
+        T = T0 * std::pow(endRatio, used);
+    }
+
+    TSP_COUNT("anneal_steps", steps);
+    TSP_COUNT("anneal_accepted", sa.accepted);
+    return sa.accepted;
+}
+
+//Takes a closed tour to a 2-opt + Or-opt optimum, anneals it for seconds and quenches it again;
+//keeps the first optimum if annealing didn't beat it
+inline void annealTour(std::vector<int>& tour, const std::vector<Point>& pts, const NeighborLists& nbrs,
+                       double seconds, uint64_t seed) {
+    std::vector<int> quenched;
+    if ((int)tour.size() - 1 >= twoLevelFrom) {
+        TwoLevelTour t(tour);
+        twoOptOrOpt(t, pts, nbrs);
+        quenched = t.closed();
+        anneal(t, pts, nbrs, seconds, seed);
+        twoOptOrOpt(t, pts, nbrs);
+        tour = t.closed();
+    } else {
+        ArrayTour t(tour);
+        twoOptOrOpt(t, pts, nbrs);
+        quenched = t.closed();
+        anneal(t, pts, nbrs, seconds, seed);
+        twoOptOrOpt(t, pts, nbrs);
+        tour = t.closed();
+    }
+    if (tourLength(quenched, pts) < tourLength(tour, pts)) tour = quenched;
+}
+
+//One rung's worth of parallel tempering state: a tour and the Annealer (RNG stream) working on
+//it, in a cache-line block of its own so threads stepping neighbouring replicas don't share lines
+template <class Tour>
+struct alignas(64) TemperingReplica {
+    Tour t;
+    Annealer<Tour> sa;
+    double length;
+
+    TemperingReplica(const std::vector<int>& closed, const std::vector<Point>& pts, const NeighborLists& nbrs,
+                     uint64_t seed, uint64_t stream)
+        : t(closed), sa(t, pts, nbrs, seed, stream), length(tourLength(closed, pts)) {}
+};
+
+/*
+    Parallel tempering for a wall-clock budget (seconds): replicas of the tour anneal side by
+    side on a ladder of temperatures and now and then trade rungs, so a tour that got shorter
+    at a hot rung moves down to be refined and a stuck cold one moves up to get loose.
+
+    Outline:
+        1) Take the tour to a 2-opt/Or-opt optimum and copy it into every replica (one per pool
+           thread, at least 4). The top rung is where anneal starts (3% of uphill moves taken);
+           each rung below is 1 - 2/sqrt(n) times the one above. A tour's length at a given
+           temperature wanders by ~sqrt(n), so rungs further apart would (almost) never swap
+        2) Rounds: the pool runs a block of Annealer steps on every replica at once. A replica
+           is only touched by the thread that has it this round and has its own tour and RNG
+           stream, so nothing is shared or locked while they step
+        3) At the end of a round (the pool is idle), neighbouring rungs i and i+1 (even pairs
+           one round, odd pairs the next) swap with probability
+           min(1, exp((1/Ti - 1/Ti+1) * (Li - Li+1))), always when the hotter tour is shorter.
+           Only the rung -> replica table changes, no tour is copied. Then the whole ladder
+           cools the way anneal's temperature does, to a thousandth by the end of the budget
+        4) Quench every replica with 2-opt + Or-opt (in parallel) and keep the shortest, or
+           the step 1 optimum if none beat it
+*/
+template <class Tour>
+void temper(std::vector<int>& tour, const std::vector<Point>& pts, const NeighborLists& nbrs, double seconds,
+            uint64_t seed, ThreadPool& pool) {
+    {
+        Tour t(tour);
+        twoOptOrOpt(t, pts, nbrs);
+        tour = t.closed();
+    }
+    if ((int)tour.size() - 1 < 8 || seconds <= 0) return;
+
+    int replicas = std::max(4, pool.size());
+    std::vector<std::unique_ptr<TemperingReplica<Tour>>> reps;
+    for (int r = 0; r < replicas; r++) reps.emplace_back(new TemperingReplica<Tour>(tour, pts, nbrs, seed, r));
+    double hot = reps[0]->sa.temperatureFor(0.03, 10000);
+    if (hot <= 0) return;
+
+    std::vector<double> T(replicas);   //rung 0 is the hottest (before cooling)
+    std::vector<int> at(replicas);     //replica running at each rung
+    double ratio = std::max(0.5, 1 - 2 / std::sqrt((double)tour.size() - 1));
+    for (int i = 0; i < replicas; i++) {
+        T[i] = hot * std::pow(ratio, i);
+        at[i] = i;
+    }
+
+    CounterRng rng(seed, (uint64_t)replicas);   //swap decisions, a stream no replica uses
+    const int block = 16384;
+    auto start = std::chrono::steady_clock::now();
+    long long rounds = 0, swaps = 0;
+    double cool = 1, used = 0;
+    do {
+        pool.parallelFor(replicas, [&](int rung, int) {
+            TemperingReplica<Tour>& r = *reps[at[rung]];
+            double temperature = T[rung] * cool;
+            for (int i = 0; i < block; i++) r.length += r.sa.step(temperature);
+        });
+
+        for (int i = (int)(rounds % 2); i + 1 < replicas; i += 2) {
+            double x = (1 / T[i] - 1 / T[i + 1]) / cool * (reps[at[i]]->length - reps[at[i + 1]]->length);
+            if (x >= 0 || rng.uniform() < std::exp(x)) {
+                std::swap(at[i], at[i + 1]);
+                swaps++;
+            }
+        }
+        rounds++;
+        used = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count() / seconds;
+        cool = std::pow(1e-3, used);
+    } while (used < 1);
+
+    std::vector<double> lengths(replicas);
+    pool.parallelFor(replicas, [&](int r, int) {
+        twoOptOrOpt(reps[r]->t, pts, nbrs);
+        lengths[r] = tourLength(reps[r]->t.closed(), pts);
+    });
+    int best = (int)(std::min_element(lengths.begin(), lengths.end()) - lengths.begin());
+    if (lengths[best] < tourLength(tour, pts)) tour = reps[best]->t.closed();
+
+    long long accepted = 0;
+    for (const auto& r : reps) accepted += r->sa.accepted;
+    TSP_COUNT("tempering_rounds", rounds);
+    TSP_COUNT("tempering_swaps", swaps);
+    TSP_COUNT("anneal_steps", rounds * block * replicas);
+    TSP_COUNT("anneal_accepted", accepted);
+}
+
+
+//Passes the solvers accept for --improve
+inline bool knownImprovement(const std::string& how) {
+    return how == "none" || how == "2opt" || how == "oropt" || how == "lk" || how == "anneal" ||
+           how == "tempering" || how == "eax";
+}
+
+template <class Tour>
+void runImprovement(Tour& t, const std::vector<Point>& pts, const std::string& how, const NeighborLists& nbrs) {
+    if (how == "lk") linKernighan(t, pts, nbrs);
+    else if (how == "oropt") twoOptOrOpt(t, pts, nbrs);
+    else twoOpt(t, pts, nbrs);
+}
+
+//Runs how on a closed tour with the representation that suits its size
+template <template <class> class Wrap = PlainTour>
+void improveClosed(std::vector<int>& tour, const std::vector<Point>& pts, const std::string& how,
+                   const NeighborLists& nbrs) {
+    if ((int)tour.size() - 1 >= twoLevelFrom) {
+        Wrap<TwoLevelTour> t(tour);
+        runImprovement(t, pts, how, nbrs);
+        tour = t.closed();
+    } else {
+        Wrap<ArrayTour> t(tour);
+        runImprovement(t, pts, how, nbrs);
+        tour = t.closed();
+    }
+}
+
+/*
+    Parallel --improve over stretches of the tour.
+
+    Outline:
+        1) Cut the tour into 2 x threads stretches of consecutive cities
+        2) On its own thread, improve each stretch as a path: its own cities, candidates and
+           tour, closed by an edge from its last city back to its first that no move may break.
+           Each stretch is written back in place of the old one, so they never collide
+        3) Shift the cuts by half a stretch (what was a border is now in the middle) and repeat,
+           until a round gains almost nothing
+        4) One serial pass over the whole tour: a stretch only ever saw its own cities as
+           candidates, so moves to a close city in another stretch are left for this pass
+           (which mostly finds the tour already done and costs little)
+
+    The first cut comes from the seed, everything else is fixed by the number of stretches,
+    so the result only depends on the seed and the thread count.
+*/
+inline void improveTourParallel(std::vector<int>& tour, const std::vector<Point>& pts, const std::string& how,
+                                const NeighborLists& nbrs, ThreadPool& pool, uint64_t seed) {
+    int n = (int)tour.size() - 1;
+    int parts = 2 * pool.size();
+    int len = n / parts;
+    if (pool.size() < 2 || len < 64) {
+        improveClosed(tour, pts, how, nbrs);
+        return;
+    }
+
+    std::vector<int> order(tour.begin(), tour.end() - 1);
+    int offset = CounterRng(seed, 0).below(len);
+    const int maxRounds = 6;
+
+    for (int round = 0; round < maxRounds; round++) {
+        std::vector<double> gained(parts, 0.0);
+        pool.parallelFor(parts, [&](int part, int) {
+            int from = offset + part * len;
+            int count = (part == parts - 1) ? n - (parts - 1) * len : len;
+            std::vector<int> ids(count);
+            std::vector<Point> sub(count);
+            for (int i = 0; i < count; i++) {
+                ids[i] = order[(from + i) % n];
+                sub[i] = pts[ids[i]];
+            }
+
+            //Locally the stretch is 0 1 ... count-1, closed by the fixed edge count-1 -> 0
+            std::vector<int> path(count + 1);
+            for (int i = 0; i < count; i++) path[i] = i;
+            path[count] = 0;
+            double before = tourLength(path, sub);
+            improveClosed<PathTour>(path, sub, how, buildNeighborLists(sub, nbrs.k));
+            gained[part] = before - tourLength(path, sub);
+
+            //path starts at 0; read it the way that doesn't start with the fixed edge
+            if (path[1] == count - 1) std::reverse(path.begin() + 1, path.end() - 1);
+            for (int i = 0; i < count; i++) order[(from + i) % n] = ids[path[i]];
+        });
+
+        double total = 0;
+        for (double g : gained) total += g;
+        offset = (offset + len / 2) % n;
+        if (total <= 1e-9 * tourLength(tour, pts)) break;
+    }
+
+    std::rotate(order.begin(), std::find(order.begin(), order.end(), 0), order.end());
+    tour.assign(order.begin(), order.end());
+    tour.push_back(0);
+    improveClosed(tour, pts, how, nbrs);
+}
+
+/*
+    EAX genetic algorithm for up to seconds (--improve=eax), starting from the given tour.
+
+    Outline:
+        1) Population of 30: the given tour (Christofides, or whatever the solver built) and
+           randomized nearest-neighbor tours (each step picks among the 3 nearest unvisited,
+           stream i of the seed), all taken to a 2-opt + Or-opt optimum on the pool's threads
+        2) eaxEvolve with what is left of the budget
+        3) Keep the best tour of the population (never worse than the given tour's optimum)
+*/
+inline void eaxTour(std::vector<int>& tour, const std::vector<Point>& pts, const NeighborLists& nbrs,
+                    double seconds, uint64_t seed, ThreadPool& pool) {
+    auto start = std::chrono::steady_clock::now();
+    const int popSize = 30;
+    if ((int)tour.size() - 1 < 8) {
+        improveClosed(tour, pts, "oropt", nbrs);
+        return;
+    }
+
+    std::vector<LinkedTour> pop(popSize);
+    pool.parallelFor(popSize, [&](int i, int) {
+        std::vector<int> t = tour;
+        if (i > 0) {
+            CounterRng rng(seed, (uint64_t)i);
+            t = randomizedGreedyTour(pts, nbrs, 3, rng);
+        }
+        improveClosed(t, pts, "oropt", nbrs);
+        pop[i] = toLinked(t, pts);
+    });
+
+    double left = seconds - std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+    int best = eaxEvolve(pop, pts, nbrs, left, seed, pool);
+    tour = toClosed(pop[best]);
+}
+
+//Runs the --improve pass on a closed tour (k = candidate list size). With parallel set and a
+//pool of more than one thread, stretches of the tour are improved side by side first.
+//anneal runs for seconds on one thread, tempering and eax for (up to) seconds on all of the pool's.
+inline void improveTour(std::vector<int>& tour, const std::vector<Point>& pts, const std::string& how,
+                        int k, ThreadPool* pool = nullptr, bool parallel = false, uint64_t seed = 1,
+                        double seconds = 0) {
+    if (how == "none" || (int)tour.size() - 1 < 4) return;
+    TSP_PHASE("improve");
+    NeighborLists nbrs = buildNeighborLists(pts, k, pool);
+    if (how == "anneal") annealTour(tour, pts, nbrs, seconds, seed);
+    else if (how == "tempering" || how == "eax") {
+        ThreadPool single(1);
+        ThreadPool& threads = pool ? *pool : single;
+        if (how == "eax") eaxTour(tour, pts, nbrs, seconds, seed, threads);
+        else if ((int)tour.size() - 1 >= twoLevelFrom) temper<TwoLevelTour>(tour, pts, nbrs, seconds, seed, threads);
+        else temper<ArrayTour>(tour, pts, nbrs, seconds, seed, threads);
+    }
+    else if (parallel && pool) improveTourParallel(tour, pts, how, nbrs, *pool, seed);
+    else improveClosed(tour, pts, how, nbrs);
+}
+
+#endif
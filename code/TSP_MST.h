@@ -0,0 +1,354 @@
+/*
+    Author: Alex Keller, Ryan Leacock, Jimmy Finnegan, Graham Baker
+    Purpose: Euclidean minimum spanning tree without the n x n matrix (Delaunay + Kruskal), and the
+             tour lower bounds that come from it
+*/
+
+#ifndef TSP_MST_H
+#define TSP_MST_H
+
+#include <algorithm>
+#include <limits>
+#include <numeric>
+#include <utility>
+#include <vector>
+
+#include "TSP_Common.h"
+
+
+/*
+    Delaunay triangulation by divide and conquer (Guibas & Stolfi quad-edge version).
+    Every edge of the Euclidean MST is a Delaunay edge, and there are at most 3n of them,
+    so Kruskal over this list gives the MST in O(n log n) time and O(n) memory.
+*/
+class Delaunay {
+public:
+    //Returns candidate edges as (city, city) pairs: the triangulation's edges plus a chain
+    //through every group of cities that share a location.
+    static std::vector<std::pair<int, int>> edges(const std::vector<Point>& pts) {
+        Delaunay dt(pts);
+        std::vector<std::pair<int, int>> out = dt.duplicates;
+        if (dt.ids.size() < 2) return out;
+        dt.build(0, (int)dt.ids.size() - 1);
+        for (int q = 0; q < (int)dt.org.size(); q += 4) {
+            if (!dt.dead[q / 4]) out.push_back({dt.org[q], dt.org[q ^ 2]});
+        }
+        return out;
+    }
+
+private:
+    /*
+        The geometric tests run on coordinates snapped to a 2^26 x 2^26 integer grid so they
+        are exact (with doubles, nearly co-circular points give inconsistent answers and the
+        triangulation falls apart). The snap moves points by ~1e-8 of the bounding box, so
+        the result is the Delaunay graph of a practically identical point set.
+    */
+    std::vector<long long> X, Y;
+    std::vector<int> ids;                           //snapped-distinct cities sorted by (x, y)
+    std::vector<std::pair<int, int>> duplicates;    //cities that snapped onto an earlier one
+
+    //Quad-edge storage: edge e lives in record e/4, rot = next in the record, sym = e^2
+    std::vector<int> onext, org;
+    std::vector<char> dead;
+
+    explicit Delaunay(const std::vector<Point>& pts) {
+        int n = (int)pts.size();
+        X.resize(n);
+        Y.resize(n);
+        if (n == 0) return;
+        double minX = pts[0].x, maxX = pts[0].x, minY = pts[0].y, maxY = pts[0].y;
+        for (const Point& p : pts) {
+            minX = std::min(minX, p.x); maxX = std::max(maxX, p.x);
+            minY = std::min(minY, p.y); maxY = std::max(maxY, p.y);
+        }
+        double span = std::max(std::max(maxX - minX, maxY - minY), 1e-300);
+        double scale = ((1 << 26) - 1) / span;
+        for (int i = 0; i < n; i++) {
+            X[i] = std::llround((pts[i].x - minX) * scale);
+            Y[i] = std::llround((pts[i].y - minY) * scale);
+        }
+
+        std::vector<int> order(n);
+        std::iota(order.begin(), order.end(), 0);
+        std::sort(order.begin(), order.end(), [&](int a, int b) {
+            return X[a] < X[b] || (X[a] == X[b] && (Y[a] < Y[b] || (Y[a] == Y[b] && a < b)));
+        });
+        for (int i = 0; i < n; i++) {
+            int c = order[i];
+            if (i > 0 && X[c] == X[order[i - 1]] && Y[c] == Y[order[i - 1]]) {
+                duplicates.push_back({order[i - 1], c});
+            } else {
+                ids.push_back(c);
+            }
+        }
+
+        onext.reserve(ids.size() * 12);
+        org.reserve(ids.size() * 12);
+    }
+
+    static int rot(int e) { return (e & ~3) | ((e + 1) & 3); }
+    static int rotInv(int e) { return (e & ~3) | ((e + 3) & 3); }
+    static int sym(int e) { return e ^ 2; }
+    int dest(int e) const { return org[sym(e)]; }
+    int lnext(int e) const { return rot(onext[rotInv(e)]); }
+    int oprev(int e) const { return rot(onext[rot(e)]); }
+    int rprev(int e) const { return onext[sym(e)]; }
+
+    int makeEdge(int a, int b) {
+        int q = (int)onext.size();
+        onext.insert(onext.end(), {q, q + 3, q + 2, q + 1});
+        org.insert(org.end(), {a, -1, b, -1});
+        dead.push_back(0);
+        return q;
+    }
+
+    void splice(int a, int b) {
+        int alpha = rot(onext[a]), beta = rot(onext[b]);
+        std::swap(onext[a], onext[b]);
+        std::swap(onext[alpha], onext[beta]);
+    }
+
+    int connect(int a, int b) {
+        int e = makeEdge(dest(a), org[b]);
+        splice(e, lnext(a));
+        splice(sym(e), b);
+        return e;
+    }
+
+    void deleteEdge(int e) {
+        splice(e, oprev(e));
+        splice(sym(e), oprev(sym(e)));
+        dead[e / 4] = 1;
+    }
+
+    //> 0 when a, b, c turn counter-clockwise
+    long long ccw(int a, int b, int c) const {
+        return (X[b] - X[a]) * (Y[c] - Y[a]) - (Y[b] - Y[a]) * (X[c] - X[a]);
+    }
+
+    //True when d is strictly inside the circle through a, b, c (a, b, c counter-clockwise)
+    bool inCircle(int a, int b, int c, int d) const {
+        long long ax = X[a] - X[d], ay = Y[a] - Y[d];
+        long long bx = X[b] - X[d], by = Y[b] - Y[d];
+        long long cx = X[c] - X[d], cy = Y[c] - Y[d];
+#if defined(__SIZEOF_INT128__)
+        typedef __int128 Wide;
+#else
+        typedef long double Wide;   //not exact, but the best MSVC offers
+#endif
+        Wide det = (Wide)(ax * ax + ay * ay) * (bx * cy - cx * by)
+                 - (Wide)(bx * bx + by * by) * (ax * cy - cx * ay)
+                 + (Wide)(cx * cx + cy * cy) * (ax * by - bx * ay);
+        return det > 0;
+    }
+
+    bool rightOf(int x, int e) const { return ccw(x, dest(e), org[e]) > 0; }
+    bool leftOf(int x, int e) const { return ccw(x, org[e], dest(e)) > 0; }
+
+    //Triangulates ids[lo..hi]. Returns (counter-clockwise convex hull edge out of the leftmost
+    //point, clockwise hull edge out of the rightmost point).
+    std::pair<int, int> build(int lo, int hi) {
+        int n = hi - lo + 1;
+        if (n == 2) {
+            int a = makeEdge(ids[lo], ids[hi]);
+            return {a, sym(a)};
+        }
+        if (n == 3) {
+            int s1 = ids[lo], s2 = ids[lo + 1], s3 = ids[hi];
+            int a = makeEdge(s1, s2);
+            int b = makeEdge(s2, s3);
+            splice(sym(a), b);
+            if (ccw(s1, s2, s3) > 0) {
+                connect(b, a);
+                return {a, sym(b)};
+            }
+            if (ccw(s1, s3, s2) > 0) {
+                int c = connect(b, a);
+                return {sym(c), c};
+            }
+            return {a, sym(b)};   //collinear
+        }
+
+        int mid = lo + n / 2;
+        auto [ldo, ldi] = build(lo, mid - 1);
+        auto [rdi, rdo] = build(mid, hi);
+
+        //Lower common tangent of the two halves
+        while (true) {
+            if (leftOf(org[rdi], ldi)) ldi = lnext(ldi);
+            else if (rightOf(org[ldi], rdi)) rdi = rprev(rdi);
+            else break;
+        }
+
+        int basel = connect(sym(rdi), ldi);
+        if (org[ldi] == org[ldo]) ldo = sym(basel);
+        if (org[rdi] == org[rdo]) rdo = basel;
+
+        //Zip the halves together from the bottom up
+        auto valid = [&](int e) { return rightOf(dest(e), basel); };
+        while (true) {
+            int lcand = onext[sym(basel)];
+            if (valid(lcand)) {
+                while (inCircle(dest(basel), org[basel], dest(lcand), dest(onext[lcand]))) {
+                    int t = onext[lcand];
+                    deleteEdge(lcand);
+                    lcand = t;
+                }
+            }
+            int rcand = oprev(basel);
+            if (valid(rcand)) {
+                while (inCircle(dest(basel), org[basel], dest(rcand), dest(oprev(rcand)))) {
+                    int t = oprev(rcand);
+                    deleteEdge(rcand);
+                    rcand = t;
+                }
+            }
+            bool lv = valid(lcand), rv = valid(rcand);
+            if (!lv && !rv) break;
+            if (!lv || (rv && inCircle(dest(lcand), org[lcand], org[rcand], dest(rcand)))) {
+                basel = connect(rcand, sym(basel));
+            } else {
+                basel = connect(sym(basel), sym(lcand));
+            }
+        }
+        return {ldo, rdo};
+    }
+};
+
+
+//Union-find with path halving and union by size
+struct DisjointSets {
+    std::vector<int> parent, size;
+
+    explicit DisjointSets(int n) : parent(n), size(n, 1) { std::iota(parent.begin(), parent.end(), 0); }
+
+    int find(int x) {
+        while (parent[x] != x) {
+            parent[x] = parent[parent[x]];
+            x = parent[x];
+        }
+        return x;
+    }
+
+    bool unite(int a, int b) {
+        a = find(a);
+        b = find(b);
+        if (a == b) return false;
+        if (size[a] < size[b]) std::swap(a, b);
+        parent[b] = a;
+        size[a] += size[b];
+        return true;
+    }
+};
+
+
+/*
+    Turns a list of tree edges into the parent[] form primMST returns (rooted at city 0,
+    parent[0] = -1) with a breadth first walk.
+*/
+inline std::vector<int> parentFromEdges(int n, const std::vector<std::pair<int, int>>& treeEdges) {
+    std::vector<int> start(n + 1, 0), nbr(2 * treeEdges.size());
+    for (auto& e : treeEdges) {
+        start[e.first + 1]++;
+        start[e.second + 1]++;
+    }
+    for (int i = 0; i < n; i++) start[i + 1] += start[i];
+    std::vector<int> fill(start.begin(), start.end() - 1);
+    for (auto& e : treeEdges) {
+        nbr[fill[e.first]++] = e.second;
+        nbr[fill[e.second]++] = e.first;
+    }
+
+    std::vector<int> parent(n, -1), queue = {0};
+    std::vector<char> seen(n, 0);
+    seen[0] = 1;
+    for (size_t h = 0; h < queue.size(); h++) {
+        int u = queue[h];
+        for (int s = start[u]; s < start[u + 1]; s++) {
+            int v = nbr[s];
+            if (!seen[v]) {
+                seen[v] = 1;
+                parent[v] = u;
+                queue.push_back(v);
+            }
+        }
+    }
+    return parent;
+}
+
+
+/*
+    Outline:
+        1) Delaunay triangulation (~3n edges), plus edges tying duplicate points together
+        2) Kruskal: sort those edges by length and keep the ones that join two components
+        3) Root the tree at city 0
+*/
+inline std::vector<int> euclideanMST(const std::vector<Point>& pts) {
+    int n = (int)pts.size();
+    std::vector<std::pair<int, int>> cand = Delaunay::edges(pts);
+
+    std::vector<double> len(cand.size());
+    std::vector<int> byLen(cand.size());
+    for (size_t e = 0; e < cand.size(); e++) len[e] = distEuclid(pts[cand[e].first], pts[cand[e].second]);
+    std::iota(byLen.begin(), byLen.end(), 0);
+    std::sort(byLen.begin(), byLen.end(), [&](int a, int b) { return len[a] < len[b]; });
+
+    DisjointSets sets(n);
+    std::vector<std::pair<int, int>> tree;
+    tree.reserve(n - 1);
+    for (int e : byLen) {
+        if (sets.unite(cand[e].first, cand[e].second)) tree.push_back(cand[e]);
+        if ((int)tree.size() == n - 1) break;
+    }
+    return parentFromEdges(n, tree);
+}
+
+
+//Lower bounds on the optimal tour length, from a minimum spanning tree
+struct TourBound {
+    double mst = 0;       //MST weight (a tour minus one edge is a spanning tree)
+    double oneTree = 0;   //best leaf 1-tree, never below mst: the bound to report
+};
+
+/*
+    A 1-tree on city v (MST of the other cities plus v's two cheapest edges) is also never
+    longer than a tour, since every tour is one. On a leaf of the MST it is free: the rest of
+    the MST is already an MST of the other cities, and the leaf's one tree edge is its
+    cheapest, so the 1-tree is the MST plus the leaf's distance to its second nearest city.
+    O(n) on top of the tree (grid 2-nearest lists), no matrix. mstParent must be an exact MST.
+*/
+inline TourBound tourLowerBound(const std::vector<Point>& pts, const std::vector<int>& mstParent) {
+    int n = (int)pts.size();
+    TourBound b;
+    std::vector<int> deg(n, 0);
+    for (int v = 0; v < n; v++) {
+        if (mstParent[v] < 0) continue;
+        b.mst += distEuclid(pts[v], pts[mstParent[v]]);
+        deg[v]++;
+        deg[mstParent[v]]++;
+    }
+    b.oneTree = b.mst;
+    if (n == 2) b.oneTree = 2 * b.mst;   //the only tour is there and back
+    if (n < 3) return b;
+
+    NeighborLists nbrs = buildNeighborLists(pts, 2);
+    double best = 0;
+    for (int v = 0; v < n; v++) {
+        if (deg[v] == 1) best = std::max(best, distEuclid(pts[v], pts[nbrs.of(v)[1]]));
+    }
+    b.oneTree += best;
+    return b;
+}
+
+//Same, building the MST with Delaunay first (O(n log n), for solvers that have no tree)
+inline TourBound tourLowerBound(const std::vector<Point>& pts) {
+    return tourLowerBound(pts, euclideanMST(pts));
+}
+
+//Worst-case gap of a tour against a lower bound, tour / bound - 1
+inline double boundGap(double tourLen, double bound) {
+    if (bound <= 0) return tourLen > 0 ? std::numeric_limits<double>::infinity() : 0.0;
+    return tourLen / bound - 1.0;
+}
+
+#endif
@@ -0,0 +1,794 @@
+/*
+    Author: Alex Keller, Ryan Leacock, Jimmy Finnegan, Graham Baker
+    Purpose: Minimum-weight perfect matching of the odd-degree vertices (the Christofides step)
+*/
+
+#ifndef TSP_MATCHING_H
+#define TSP_MATCHING_H
+
+#include <algorithm>
+#include <cmath>
+#include <cstdint>
+#include <cstring>
+#include <functional>
+#include <numeric>
+#include <queue>
+#include <utility>
+#include <vector>
+
+#include "TSP_Common.h"
+
+
+/*
+    Exact minimum-weight perfect matching on a sparse graph (Edmonds' blossom algorithm).
+
+    This is the primal-dual method in the form of Van Rantwijk's maximum weight matching
+    (edge weights are turned around as M - cost and maximum cardinality is forced), with the
+    changes that matter for big sparse inputs, as in Blossom V:
+        - duals start from a greedy solution (each vertex gets half its cheapest edge, then
+          is raised to its next tight edge) and every tight edge between free vertices is
+          matched up front, so only a few augmentations are left for the real algorithm
+        - each stage grows a single alternating tree from one free vertex and augments as soon
+          as it reaches another free vertex; all bookkeeping is reset only where the tree went,
+          so a stage costs the size of its tree rather than the size of the graph
+        - the dual change ("delta") of each step comes from three priority queues (free
+          vertex edges, S-S blossom edges, T-blossom duals) instead of a scan of all vertices
+        - S/T duals are not touched one by one on every step: they move with a global clock
+          and are written back when a vertex changes blossom or the stage ends
+    Queue entries are checked when they come out; anything stale is recomputed and pushed back
+    (a stale key can only be too small, so the smallest valid key is always found).
+
+    Costs are rounded to integers (2^30 steps over the longest edge) so tightness tests are exact.
+    The graph must contain a perfect matching; the caller adds a known one to the candidates.
+*/
+class BlossomMatching {
+public:
+    //edges: (u, v) over vertices 0..n-1, cost: matching edge lengths. Returns mate[] (-1 = none).
+    static std::vector<int> solve(int n, const std::vector<std::pair<int, int>>& edges,
+                                  const std::vector<double>& cost) {
+        BlossomMatching bm(n, edges, cost);
+        bm.run();
+        std::vector<int> result(n, -1);
+        for (int v = 0; v < n; v++) {
+            if (bm.mate[v] >= 0) result[v] = bm.endpoint[bm.mate[v]];
+        }
+        return result;
+    }
+
+private:
+    typedef long long W;
+    typedef std::pair<W, int> Entry;   //(key, item)
+    typedef std::priority_queue<Entry, std::vector<Entry>, std::greater<Entry>> MinQueue;
+
+    int nv, ne;
+    std::vector<int> edgeU, edgeV;
+    std::vector<W> weight;                     //M - cost, doubled so all slacks stay even
+    std::vector<int> endpoint;                 //endpoint[2k] = u, endpoint[2k+1] = v of edge k
+    std::vector<std::vector<int>> neighbend;   //remote endpoints of each vertex's edges
+
+    std::vector<int> mate, label, labelend, inblossom, blossomparent, blossombase, bestedge;
+    std::vector<int> leafNext, leafHead, leafTail;   //each blossom's vertices as one linked chain
+    std::vector<std::vector<int>> blossomchilds, blossomendps, blossombestedges;
+    std::vector<char> hasBestList;
+    std::vector<int> unusedblossoms;
+    std::vector<W> dualvar;
+    std::vector<char> allowedge;
+    std::vector<int> queue;
+    std::vector<int> bestedgeto;               //addBlossom scratch, kept all -1 between calls
+    std::vector<int> touched, allowed;         //labels/best edges and allowed edges set this stage
+
+    //Lazy duals: a top-level blossom labelled at clock time since[b] has moved by (clock - since[b])
+    W clock = 0;
+    std::vector<W> since;
+    MinQueue delta2, delta3, delta4;
+
+    BlossomMatching(int n, const std::vector<std::pair<int, int>>& edges, const std::vector<double>& cost)
+        : nv(n), ne((int)edges.size()) {
+        double maxCost = 0.0;
+        for (double c : cost) maxCost = std::max(maxCost, c);
+        double scale = (maxCost > 0) ? (double)(1 << 30) / maxCost : 1.0;
+
+        std::vector<W> c(ne);
+        W maxC = 0;
+        edgeU.resize(ne);
+        edgeV.resize(ne);
+        endpoint.resize(2 * ne);
+        neighbend.assign(nv, {});
+        for (int k = 0; k < ne; k++) {
+            edgeU[k] = edges[k].first;
+            edgeV[k] = edges[k].second;
+            endpoint[2 * k] = edgeU[k];
+            endpoint[2 * k + 1] = edgeV[k];
+            neighbend[edgeU[k]].push_back(2 * k + 1);
+            neighbend[edgeV[k]].push_back(2 * k);
+            c[k] = 2 * (W)std::llround(cost[k] * scale);
+            maxC = std::max(maxC, c[k]);
+        }
+        W M = maxC + 2;
+        weight.resize(ne);
+        for (int k = 0; k < ne; k++) weight[k] = M - c[k];
+
+        mate.assign(nv, -1);
+        label.assign(2 * nv, 0);
+        labelend.assign(2 * nv, -1);
+        inblossom.resize(nv);
+        for (int v = 0; v < nv; v++) inblossom[v] = v;
+        blossomparent.assign(2 * nv, -1);
+        leafNext.assign(nv, -1);
+        leafHead.assign(2 * nv, -1);
+        leafTail.assign(2 * nv, -1);
+        for (int v = 0; v < nv; v++) leafHead[v] = leafTail[v] = v;
+        blossomchilds.assign(2 * nv, {});
+        blossombase.assign(2 * nv, -1);
+        for (int v = 0; v < nv; v++) blossombase[v] = v;
+        blossomendps.assign(2 * nv, {});
+        bestedge.assign(2 * nv, -1);
+        blossombestedges.assign(2 * nv, {});
+        hasBestList.assign(2 * nv, 0);
+        for (int b = 2 * nv - 1; b >= nv; b--) unusedblossoms.push_back(b);
+        dualvar.assign(2 * nv, 0);
+        allowedge.assign(ne, 0);
+        bestedgeto.assign(2 * nv, -1);
+        since.assign(2 * nv, 0);
+
+        greedyStart(c, M);
+    }
+
+    /*
+        Cost-form duals y: y[v] = half the cheapest edge at v, then each vertex that's still
+        free is raised until one of its edges goes tight and matched along it if possible.
+        In Van Rantwijk's form the vertex dual is M - 2*y[v] (slack = 2 * (c - y[u] - y[v])).
+    */
+    void greedyStart(const std::vector<W>& c, W M) {
+        std::vector<W> y(nv, 0);
+        for (int v = 0; v < nv; v++) {
+            W lo = -1;
+            for (int p : neighbend[v]) {
+                W ck = c[p / 2];
+                if (lo < 0 || ck < lo) lo = ck;
+            }
+            y[v] = (lo < 0) ? 0 : lo / 2;
+        }
+
+        auto slackC = [&](int k) { return c[k] - y[edgeU[k]] - y[edgeV[k]]; };
+        auto matchEdge = [&](int k) {
+            mate[edgeU[k]] = 2 * k + 1;
+            mate[edgeV[k]] = 2 * k;
+        };
+
+        for (int v = 0; v < nv; v++) {
+            if (mate[v] >= 0) continue;
+            //Raise y[v] to the smallest slack so at least one edge is tight
+            W lo = -1;
+            for (int p : neighbend[v]) {
+                W s = slackC(p / 2);
+                if (lo < 0 || s < lo) lo = s;
+            }
+            if (lo > 0) y[v] += lo;
+            for (int p : neighbend[v]) {
+                int k = p / 2, u = endpoint[p];
+                if (mate[u] < 0 && slackC(k) == 0) {
+                    matchEdge(k);
+                    break;
+                }
+            }
+        }
+
+        for (int v = 0; v < nv; v++) dualvar[v] = M - 2 * y[v];
+    }
+
+    //Current dual of vertex v / blossom b (see since[] above)
+    W vertexDual(int v) const {
+        int b = inblossom[v];
+        int t = label[b];
+        if (t == 1) return dualvar[v] - (clock - since[b]);
+        if (t == 2) return dualvar[v] + (clock - since[b]);
+        return dualvar[v];
+    }
+
+    W blossomDual(int b) const {
+        if (blossomparent[b] != -1) return dualvar[b];
+        if (label[b] == 1) return dualvar[b] + (clock - since[b]);
+        if (label[b] == 2) return dualvar[b] - (clock - since[b]);
+        return dualvar[b];
+    }
+
+    //Write the moving part back into dualvar (call before v changes blossom / b stops being top-level)
+    void commitVertex(int v) { dualvar[v] = vertexDual(v); }
+    void commitBlossom(int b) { dualvar[b] = blossomDual(b); since[b] = clock; }
+
+    W slack(int k) const { return vertexDual(edgeU[k]) + vertexDual(edgeV[k]) - 2 * weight[k]; }
+
+    void leaves(int b, std::vector<int>& out) const {
+        for (int x = leafHead[b];; x = leafNext[x]) {
+            out.push_back(x);
+            if (x == leafTail[b]) break;
+        }
+    }
+
+    //Chain the children's vertex lists in child order (after forming or rotating b)
+    void linkLeaves(int b) {
+        const std::vector<int>& childs = blossomchilds[b];
+        for (size_t i = 0; i + 1 < childs.size(); i++) leafNext[leafTail[childs[i]]] = leafHead[childs[i + 1]];
+        leafNext[leafTail[childs.back()]] = -1;
+        leafHead[b] = leafHead[childs.front()];
+        leafTail[b] = leafTail[childs.back()];
+    }
+
+    void setLabel(int b, int t) {
+        //Only ever called on blossoms going 0 -> t (or re-stamped at the same clock)
+        label[b] = t;
+        since[b] = clock;
+        touched.push_back(b);
+        if (t == 2 && b >= nv) delta4.push({dualvar[b] + clock, b});
+    }
+
+    void setVertexBest(int w, int k) {
+        bestedge[w] = k;
+        touched.push_back(w);
+        delta2.push({slack(k) + clock, w});
+    }
+
+    void setBlossomBest(int b, int k) {
+        bestedge[b] = k;
+        touched.push_back(b);
+        if (k >= 0) delta3.push({slack(k) / 2 + clock, b});
+    }
+
+    void allow(int k) {
+        if (!allowedge[k]) allowed.push_back(k);
+        allowedge[k] = 1;
+    }
+
+    void assignLabel(int w, int t, int p) {
+        while (true) {
+            int b = inblossom[w];
+            label[w] = t;
+            touched.push_back(w);
+            setLabel(b, t);
+            labelend[w] = labelend[b] = p;
+            bestedge[w] = bestedge[b] = -1;
+            if (t == 1) {
+                leaves(b, queue);
+                return;
+            }
+            int base = blossombase[b];
+            w = endpoint[mate[base]];
+            t = 1;
+            p = mate[base] ^ 1;
+        }
+    }
+
+    int scanBlossom(int v, int w) {
+        std::vector<int> path;
+        int base = -1;
+        while (v != -1 || w != -1) {
+            int b = inblossom[v];
+            if (label[b] & 4) {
+                base = blossombase[b];
+                break;
+            }
+            path.push_back(b);
+            label[b] = 5;
+            if (labelend[b] == -1) {
+                v = -1;
+            } else {
+                v = endpoint[labelend[b]];
+                b = inblossom[v];
+                v = endpoint[labelend[b]];
+            }
+            if (w != -1) std::swap(v, w);
+        }
+        for (int b : path) label[b] = 1;
+        return base;
+    }
+
+    void addBlossom(int base, int k) {
+        int v = edgeU[k], w = edgeV[k];
+        int bb = inblossom[base], bv = inblossom[v], bw = inblossom[w];
+        int b = unusedblossoms.back();
+        unusedblossoms.pop_back();
+        blossombase[b] = base;
+        blossomparent[b] = -1;
+        blossomparent[bb] = b;
+        std::vector<int>& path = blossomchilds[b];
+        std::vector<int>& endps = blossomendps[b];
+        path.clear();
+        endps.clear();
+        while (bv != bb) {
+            blossomparent[bv] = b;
+            path.push_back(bv);
+            endps.push_back(labelend[bv]);
+            v = endpoint[labelend[bv]];
+            bv = inblossom[v];
+        }
+        path.push_back(bb);
+        std::reverse(path.begin(), path.end());
+        std::reverse(endps.begin(), endps.end());
+        endps.push_back(2 * k);
+        while (bw != bb) {
+            blossomparent[bw] = b;
+            path.push_back(bw);
+            endps.push_back(labelend[bw] ^ 1);
+            w = endpoint[labelend[bw]];
+            bw = inblossom[w];
+        }
+
+        //Freeze the children's duals and pull their vertices into b
+        std::vector<int> lv;
+        for (int child : path) {
+            lv.clear();
+            leaves(child, lv);
+            for (int x : lv) {
+                commitVertex(x);
+                if (label[child] == 2) queue.push_back(x);
+                inblossom[x] = b;
+            }
+            if (child >= nv) {
+                blossomparent[child] = -1;   //so blossomDual sees it as top-level one last time
+                commitBlossom(child);
+                blossomparent[child] = b;
+            }
+        }
+        linkLeaves(b);
+        label[b] = 1;
+        since[b] = clock;
+        touched.push_back(b);
+        labelend[b] = labelend[bb];
+        dualvar[b] = 0;
+
+        //Best edges from b to every other S-blossom
+        std::vector<int> reached;
+        auto consider = [&](int kk) {
+            int j = (inblossom[edgeU[kk]] == b) ? edgeV[kk] : edgeU[kk];
+            int bj = inblossom[j];
+            if (bj != b && label[bj] == 1 && (bestedgeto[bj] == -1 || slack(kk) < slack(bestedgeto[bj]))) {
+                if (bestedgeto[bj] == -1) reached.push_back(bj);
+                bestedgeto[bj] = kk;
+            }
+        };
+        for (int child : path) {
+            if (!hasBestList[child]) {
+                for (int x = leafHead[child];; x = leafNext[x]) {
+                    for (int p : neighbend[x]) consider(p / 2);
+                    if (x == leafTail[child]) break;
+                }
+            } else {
+                for (int kk : blossombestedges[child]) consider(kk);
+            }
+            blossombestedges[child].clear();
+            hasBestList[child] = 0;
+            bestedge[child] = -1;
+        }
+        blossombestedges[b].clear();
+        for (int bj : reached) {
+            blossombestedges[b].push_back(bestedgeto[bj]);
+            bestedgeto[bj] = -1;
+        }
+        hasBestList[b] = 1;
+        int best = -1;
+        for (int kk : blossombestedges[b]) {
+            if (best == -1 || slack(kk) < slack(best)) best = kk;
+        }
+        setBlossomBest(b, best);
+    }
+
+    void expandBlossom(int b, bool endstage) {
+        //b's vertices go back to its children (freeze their duals first)
+        std::vector<int> all, lv;
+        leaves(b, all);
+        for (int x : all) commitVertex(x);
+        for (int s : blossomchilds[b]) {
+            leafNext[leafTail[s]] = -1;
+            blossomparent[s] = -1;
+            since[s] = clock;
+            if (s < nv) {
+                inblossom[s] = s;
+            } else if (endstage && dualvar[s] == 0) {
+                expandBlossom(s, endstage);
+            } else {
+                for (int x = leafHead[s];; x = leafNext[x]) {
+                    inblossom[x] = s;
+                    if (x == leafTail[s]) break;
+                }
+            }
+        }
+
+        if (!endstage && label[b] == 2) {
+            std::vector<int>& childs = blossomchilds[b];
+            std::vector<int>& endps = blossomendps[b];
+            int len = (int)childs.size();
+            int entrychild = inblossom[endpoint[labelend[b] ^ 1]];
+            int j = (int)(std::find(childs.begin(), childs.end(), entrychild) - childs.begin());
+            int jstep, endptrick;
+            if (j & 1) {
+                j -= len;
+                jstep = 1;
+                endptrick = 0;
+            } else {
+                jstep = -1;
+                endptrick = 1;
+            }
+            auto at = [&](const std::vector<int>& vec, int idx) { return vec[((idx % len) + len) % len]; };
+
+            int p = labelend[b];
+            while (j != 0) {
+                label[endpoint[p ^ 1]] = 0;
+                label[endpoint[at(endps, j - endptrick) ^ endptrick ^ 1]] = 0;
+                clearTopLabel(endpoint[p ^ 1]);
+                assignLabel(endpoint[p ^ 1], 2, p);
+                allow(at(endps, j - endptrick) / 2);
+                j += jstep;
+                p = at(endps, j - endptrick) ^ endptrick;
+                allow(p / 2);
+                j += jstep;
+            }
+            int bv = at(childs, j);
+            label[endpoint[p ^ 1]] = 2;
+            touched.push_back(endpoint[p ^ 1]);
+            setLabel(bv, 2);
+            labelend[endpoint[p ^ 1]] = labelend[bv] = p;
+            bestedge[bv] = -1;
+            j += jstep;
+            while (at(childs, j) != entrychild) {
+                bv = at(childs, j);
+                if (label[bv] == 1) {
+                    j += jstep;
+                    continue;
+                }
+                lv.clear();
+                leaves(bv, lv);
+                int found = -1;
+                for (int x : lv) {
+                    if (label[x] != 0) {
+                        found = x;
+                        break;
+                    }
+                }
+                if (found >= 0) {
+                    label[found] = 0;
+                    label[endpoint[mate[blossombase[bv]]]] = 0;
+                    label[bv] = 0;
+                    assignLabel(found, 2, labelend[found]);
+                }
+                j += jstep;
+            }
+
+            //Vertices left unlabelled lost their queue entries while they were T
+            for (int x : all) {
+                if (label[inblossom[x]] == 0 && bestedge[x] != -1) delta2.push({slack(bestedge[x]) + clock, x});
+            }
+        }
+
+        label[b] = labelend[b] = -1;
+        blossomchilds[b].clear();
+        blossomendps[b].clear();
+        blossombase[b] = -1;
+        blossombestedges[b].clear();
+        hasBestList[b] = 0;
+        bestedge[b] = -1;
+        unusedblossoms.push_back(b);
+    }
+
+    //A child that just became top-level may carry a stale label from before it was nested
+    void clearTopLabel(int v) { label[inblossom[v]] = 0; }
+
+    void augmentBlossom(int b, int v) {
+        int t = v;
+        while (blossomparent[t] != b) t = blossomparent[t];
+        if (t >= nv) augmentBlossom(t, v);
+
+        std::vector<int>& childs = blossomchilds[b];
+        std::vector<int>& endps = blossomendps[b];
+        int len = (int)childs.size();
+        int i = (int)(std::find(childs.begin(), childs.end(), t) - childs.begin());
+        int j = i, jstep, endptrick;
+        if (i & 1) {
+            j -= len;
+            jstep = 1;
+            endptrick = 0;
+        } else {
+            jstep = -1;
+            endptrick = 1;
+        }
+        auto at = [&](const std::vector<int>& vec, int idx) { return vec[((idx % len) + len) % len]; };
+
+        while (j != 0) {
+            j += jstep;
+            t = at(childs, j);
+            int p = at(endps, j - endptrick) ^ endptrick;
+            if (t >= nv) augmentBlossom(t, endpoint[p]);
+            j += jstep;
+            t = at(childs, j);
+            if (t >= nv) augmentBlossom(t, endpoint[p ^ 1]);
+            mate[endpoint[p]] = p ^ 1;
+            mate[endpoint[p ^ 1]] = p;
+        }
+        std::rotate(childs.begin(), childs.begin() + i, childs.end());
+        std::rotate(endps.begin(), endps.begin() + i, endps.end());
+        blossombase[b] = blossombase[childs[0]];
+        linkLeaves(b);
+    }
+
+    void augmentMatching(int k) {
+        int ends[2][2] = {{edgeU[k], 2 * k + 1}, {edgeV[k], 2 * k}};
+        for (auto& sp : ends) {
+            int s = sp[0], p = sp[1];
+            while (true) {
+                int bs = inblossom[s];
+                if (bs >= nv) augmentBlossom(bs, s);
+                mate[s] = p;
+                if (labelend[bs] == -1) break;
+                int t = endpoint[labelend[bs]];
+                int bt = inblossom[t];
+                s = endpoint[labelend[bt]];
+                int j = endpoint[labelend[bt] ^ 1];
+                if (bt >= nv) augmentBlossom(bt, j);
+                mate[j] = labelend[bt];
+                p = labelend[bt] ^ 1;
+            }
+        }
+    }
+
+    //Pop the smallest key that is still accurate; -1 if the queue has nothing valid
+    template <class Valid, class Key>
+    int popValid(MinQueue& q, Valid valid, Key key, W& out) {
+        while (!q.empty()) {
+            Entry e = q.top();
+            if (!valid(e.second)) {
+                q.pop();
+                continue;
+            }
+            W real = key(e.second);
+            if (real != e.first) {
+                q.pop();
+                q.push({real, e.second});
+                continue;
+            }
+            out = e.first;
+            return e.second;
+        }
+        return -1;
+    }
+
+    void run() {
+        std::vector<int> lv;
+        int root = 0;
+        while (true) {
+            //One alternating tree per stage, grown from the next free vertex
+            while (root < nv && mate[root] != -1) root++;
+            if (root == nv) break;   //everything matched
+            queue.clear();
+            delta2 = MinQueue();
+            delta3 = MinQueue();
+            delta4 = MinQueue();
+            assignLabel(root, 1, -1);
+
+            bool augmented = false;
+            while (true) {
+                while (!queue.empty() && !augmented) {
+                    int v = queue.back();
+                    queue.pop_back();
+                    for (int p : neighbend[v]) {
+                        int k = p / 2, w = endpoint[p];
+                        if (inblossom[v] == inblossom[w]) continue;
+                        W kslack = 0;
+                        if (!allowedge[k]) {
+                            kslack = slack(k);
+                            if (kslack <= 0) allow(k);
+                        }
+                        if (allowedge[k]) {
+                            if (label[inblossom[w]] == 0) {
+                                if (mate[blossombase[inblossom[w]]] == -1) {
+                                    //Reached another free vertex: w's side is a one-blossom path
+                                    assignLabel(w, 1, -1);
+                                    augmentMatching(k);
+                                    augmented = true;
+                                    break;
+                                }
+                                assignLabel(w, 2, p ^ 1);
+                            } else if (label[inblossom[w]] == 1) {
+                                int base = scanBlossom(v, w);
+                                if (base >= 0) {
+                                    addBlossom(base, k);
+                                } else {
+                                    augmentMatching(k);
+                                    augmented = true;
+                                    break;
+                                }
+                            } else if (label[w] == 0) {
+                                label[w] = 2;
+                                labelend[w] = p ^ 1;
+                                touched.push_back(w);
+                            }
+                        } else if (label[inblossom[w]] == 1) {
+                            int b = inblossom[v];
+                            if (bestedge[b] == -1 || kslack < slack(bestedge[b])) setBlossomBest(b, k);
+                        } else if (label[w] == 0) {
+                            if (bestedge[w] == -1 || kslack < slack(bestedge[w])) setVertexBest(w, k);
+                        }
+                    }
+                }
+                if (augmented) break;
+
+                //Smallest dual change that makes progress
+                int type = -1, deltaEdge = -1, deltaBlossom = -1;
+                W delta = 0, d;
+                int v2 = popValid(delta2,
+                    [&](int v) { return label[inblossom[v]] == 0 && bestedge[v] != -1; },
+                    [&](int v) { return slack(bestedge[v]) + clock; }, d);
+                if (v2 >= 0) {
+                    type = 2;
+                    delta = d - clock;
+                    deltaEdge = bestedge[v2];
+                }
+                int b3 = popValid(delta3,
+                    [&](int b) { return blossomparent[b] == -1 && label[b] == 1 && bestedge[b] != -1; },
+                    [&](int b) { return slack(bestedge[b]) / 2 + clock; }, d);
+                if (b3 >= 0 && (type == -1 || d - clock < delta)) {
+                    type = 3;
+                    delta = d - clock;
+                    deltaEdge = bestedge[b3];
+                }
+                int b4 = popValid(delta4,
+                    [&](int b) { return blossombase[b] >= 0 && blossomparent[b] == -1 && label[b] == 2; },
+                    [&](int b) { return blossomDual(b) + clock; }, d);
+                if (b4 >= 0 && (type == -1 || d - clock < delta)) {
+                    type = 4;
+                    delta = d - clock;
+                    deltaBlossom = b4;
+                }
+                if (type == -1) break;   //this tree can't reach another free vertex
+
+                clock += delta;
+
+                if (type == 2) {
+                    allow(deltaEdge);
+                    int i = edgeU[deltaEdge], j = edgeV[deltaEdge];
+                    if (label[inblossom[i]] == 0) std::swap(i, j);
+                    queue.push_back(i);
+                } else if (type == 3) {
+                    allow(deltaEdge);
+                    queue.push_back(edgeU[deltaEdge]);
+                } else {
+                    expandBlossom(deltaBlossom, false);
+                }
+            }
+
+            //Stage over: freeze the duals of everything this tree labelled
+            for (int x : touched) {
+                bool top = (x < nv) ? inblossom[x] == x : (blossombase[x] >= 0 && blossomparent[x] == -1);
+                if (!top || (label[x] != 1 && label[x] != 2)) continue;
+                lv.clear();
+                leaves(x, lv);
+                for (int v : lv) commitVertex(v);
+                if (x >= nv) commitBlossom(x);
+                else since[x] = clock;
+            }
+            if (!augmented) root++;   //no partner reachable in the candidate graph; leave it free
+
+            for (int x : touched) {
+                if (x >= nv && blossomparent[x] == -1 && blossombase[x] >= 0 && label[x] == 1 && dualvar[x] == 0) {
+                    expandBlossom(x, true);
+                }
+            }
+
+            //Reset only what this stage touched
+            for (int x : touched) {
+                label[x] = 0;
+                labelend[x] = -1;
+                bestedge[x] = -1;
+                if (x >= nv) {
+                    blossombestedges[x].clear();
+                    hasBestList[x] = 0;
+                }
+            }
+            touched.clear();
+            for (int k : allowed) allowedge[k] = 0;
+            allowed.clear();
+        }
+    }
+};
+
+
+//Indices 0..n-1 ordered by key (stable LSD radix sort, two 16-bit passes)
+inline std::vector<int> radixOrder(const std::vector<uint32_t>& key) {
+    size_t n = key.size();
+    std::vector<int> order(n), tmp(n);
+    std::iota(order.begin(), order.end(), 0);
+    std::vector<size_t> count(65537);
+    for (int shift = 0; shift < 32; shift += 16) {
+        std::fill(count.begin(), count.end(), 0);
+        for (size_t i = 0; i < n; i++) count[((key[order[i]] >> shift) & 0xFFFF) + 1]++;
+        for (size_t d = 1; d < count.size(); d++) count[d] += count[d - 1];
+        for (size_t i = 0; i < n; i++) tmp[count[(key[order[i]] >> shift) & 0xFFFF]++] = order[i];
+        order.swap(tmp);
+    }
+    return order;
+}
+
+/*
+    Global greedy matching: every pair from the k-nearest lists of the odd vertices (grid search
+    over just the odd points) is sorted by length once, then pairs are accepted shortest first
+    whenever both ends are still free. Vertices left over (all their candidates got taken) go
+    round again with neighbor lists over just the leftovers; once few enough remain the lists
+    cover every pair, so everything gets matched. Returns index pairs into odd[].
+*/
+inline std::vector<std::pair<int, int>> globalGreedyPairs(const std::vector<int>& odd, const std::vector<Point>& pts, int k) {
+    std::vector<std::pair<int, int>> pairs;
+    std::vector<int> rest(odd.size());
+    std::iota(rest.begin(), rest.end(), 0);
+
+    while (rest.size() > 1) {
+        int r = (int)rest.size();
+        std::vector<Point> sub(r);
+        for (int a = 0; a < r; a++) sub[a] = pts[odd[rest[a]]];
+        NeighborLists nbrs = buildNeighborLists(sub, std::max(1, std::min(k, r - 1)));
+
+        //Each pair once: a mutual pair is kept from its smaller end only
+        std::vector<uint32_t> key;
+        std::vector<int> ends;
+        for (int a = 0; a < r; a++) {
+            for (int t = 0; t < nbrs.k; t++) {
+                int b = nbrs.of(a)[t];
+                if (a > b && std::find(nbrs.of(b), nbrs.of(b) + nbrs.k, a) != nbrs.of(b) + nbrs.k) continue;
+                float len = (float)distEuclid(sub[a], sub[b]);
+                uint32_t bits;
+                std::memcpy(&bits, &len, sizeof bits);   //non-negative floats order like their bits
+                key.push_back(bits);
+                ends.push_back(a);
+                ends.push_back(b);
+            }
+        }
+
+        std::vector<char> used(r, 0);
+        for (int c : radixOrder(key)) {
+            int a = ends[2 * c], b = ends[2 * c + 1];
+            if (used[a] || used[b]) continue;
+            used[a] = used[b] = 1;
+            pairs.push_back({rest[a], rest[b]});
+        }
+
+        std::vector<int> next;
+        for (int a = 0; a < r; a++) {
+            if (!used[a]) next.push_back(rest[a]);
+        }
+        if ((int)next.size() == r) {
+            //No pair this round (can't happen with k >= 1): pair the rest in order so the loop ends
+            for (int a = 0; a + 1 < r; a += 2) pairs.push_back({rest[a], rest[a + 1]});
+            break;
+        }
+        rest.swap(next);
+    }
+    return pairs;
+}
+
+
+/*
+    Candidate edges for the odd-vertex matching: each odd vertex to its k nearest odd vertices
+    (grid search over just the odd points), plus the edges of a known perfect matching so that
+    one is guaranteed to exist in the sparse graph. Indices are positions in odd[].
+*/
+inline std::vector<std::pair<int, int>> oddCandidateEdges(const std::vector<int>& odd, const std::vector<Point>& pts,
+                                                          int k, const std::vector<std::pair<int, int>>& known) {
+    int m = (int)odd.size();
+    std::vector<Point> oddPts(m);
+    for (int i = 0; i < m; i++) oddPts[i] = pts[odd[i]];
+    NeighborLists nbrs = buildNeighborLists(oddPts, k);
+
+    std::vector<std::pair<int, int>> edges = known;
+    for (auto& e : edges) {
+        if (e.first > e.second) std::swap(e.first, e.second);
+    }
+    for (int i = 0; i < m; i++) {
+        for (int t = 0; t < nbrs.k; t++) {
+            int j = nbrs.of(i)[t];
+            edges.push_back({std::min(i, j), std::max(i, j)});
+        }
+    }
+    std::sort(edges.begin(), edges.end());
+    edges.erase(std::unique(edges.begin(), edges.end()), edges.end());
+    return edges;
+}
+
+#endif
@@ -0,0 +1,152 @@
+/*
+    Author: Alex Keller, Ryan Leacock, Jimmy Finnegan, Graham Baker
+    Purpose: Optional per-phase timing and counters for the solvers (compiled out by default)
+*/
+
+#ifndef TSP_STATS_H
+#define TSP_STATS_H
+
+/*
+    Build with -DTSP_STATS to record, for one run, the wall time of every phase and a few
+    counters, written out as JSON at the end. Without it every macro below expands to nothing,
+    so a normal build carries no timers, no counters and no extra code in the hot loops.
+
+        TSP_PHASE("mst");               //times from here to the end of the enclosing scope
+        TSP_COUNT("odd_vertices", n);   //adds n to a named counter
+        TSP_COUNT_DIST(n);              //adds n distance evaluations (safe in hot loops)
+        TSP_WRITE_STATS(path, solver, input, cities, tourLength);
+
+    A phase entered more than once (per restart, per thread) is summed, with its call count.
+    Phases may nest (neighbor_lists inside construct), so their times can overlap.
+    Distance evaluations are counted per thread without locks and added up when written.
+*/
+#ifdef TSP_STATS
+
+#include <atomic>
+#include <chrono>
+#include <deque>
+#include <fstream>
+#include <iomanip>
+#include <mutex>
+#include <string>
+#include <vector>
+
+class RunStats {
+public:
+    static RunStats& get() {
+        static RunStats stats;
+        return stats;
+    }
+
+    void addPhase(const std::string& name, double seconds) {
+        std::lock_guard<std::mutex> lock(mtx);
+        for (Phase& p : phases) {
+            if (p.name == name) {
+                p.seconds += seconds;
+                p.calls++;
+                return;
+            }
+        }
+        phases.push_back({name, seconds, 1});
+    }
+
+    void count(const std::string& name, long long n) {
+        std::lock_guard<std::mutex> lock(mtx);
+        for (auto& c : counters) {
+            if (c.first == name) {
+                c.second += n;
+                return;
+            }
+        }
+        counters.push_back({name, n});
+    }
+
+    //Each thread gets its own slot, kept alive here even after the thread exits
+    void addDistanceEvals(long long n) {
+        thread_local std::atomic<long long>* slot = nullptr;
+        if (!slot) {
+            std::lock_guard<std::mutex> lock(mtx);
+            distSlots.emplace_back(0);
+            slot = &distSlots.back();
+        }
+        slot->store(slot->load(std::memory_order_relaxed) + n, std::memory_order_relaxed);
+    }
+
+    void writeJson(const std::string& path, const std::string& solver, const std::string& input,
+                   int cities, double tourLength) {
+        std::lock_guard<std::mutex> lock(mtx);
+        long long dist = 0;
+        for (const auto& s : distSlots) dist += s.load(std::memory_order_relaxed);
+
+        std::ofstream out(path);
+        if (!out.is_open()) return;
+        out << std::fixed << std::setprecision(6);
+        out << "{\n";
+        out << "  \"solver\": \"" << escape(solver) << "\",\n";
+        out << "  \"input\": \"" << escape(input) << "\",\n";
+        out << "  \"cities\": " << cities << ",\n";
+        out << "  \"tour_length\": " << tourLength << ",\n";
+        out << "  \"phases\": [";
+        for (size_t i = 0; i < phases.size(); i++) {
+            out << (i ? ",\n" : "\n") << "    {\"name\": \"" << escape(phases[i].name) << "\", \"seconds\": "
+                << phases[i].seconds << ", \"calls\": " << phases[i].calls << "}";
+        }
+        out << "\n  ],\n";
+        out << "  \"counters\": {\n";
+        out << "    \"distance_evals\": " << dist;
+        for (const auto& c : counters) out << ",\n    \"" << escape(c.first) << "\": " << c.second;
+        out << "\n  }\n}\n";
+    }
+
+private:
+    struct Phase {
+        std::string name;
+        double seconds;
+        long long calls;
+    };
+
+    std::mutex mtx;
+    std::vector<Phase> phases;
+    std::vector<std::pair<std::string, long long>> counters;
+    std::deque<std::atomic<long long>> distSlots;
+
+    static std::string escape(const std::string& s) {
+        std::string r;
+        for (char c : s) {
+            if (c == '"' || c == '\\') r += '\\';
+            r += c;
+        }
+        return r;
+    }
+};
+
+//Adds the time until the end of its scope to a named phase
+class PhaseTimer {
+public:
+    explicit PhaseTimer(const char* name) : name(name), t0(std::chrono::steady_clock::now()) {}
+    ~PhaseTimer() {
+        RunStats::get().addPhase(name, std::chrono::duration<double>(std::chrono::steady_clock::now() - t0).count());
+    }
+
+private:
+    const char* name;
+    std::chrono::steady_clock::time_point t0;
+};
+
+#define TSP_STATS_CAT2(a, b) a##b
+#define TSP_STATS_CAT(a, b) TSP_STATS_CAT2(a, b)
+#define TSP_PHASE(name) PhaseTimer TSP_STATS_CAT(tspPhase_, __LINE__)(name)
+#define TSP_COUNT(name, n) RunStats::get().count((name), (long long)(n))
+#define TSP_COUNT_DIST(n) RunStats::get().addDistanceEvals((long long)(n))
+#define TSP_WRITE_STATS(path, solver, input, cities, length) RunStats::get().writeJson((path), (solver), (input), (cities), (length))
+
+#else
+
+#define TSP_PHASE(name) ((void)0)
+#define TSP_COUNT(name, n) ((void)0)
+#define TSP_COUNT_DIST(n) ((void)0)
+#define TSP_WRITE_STATS(path, solver, input, cities, length) ((void)0)
+
+#endif
+
+#endif
@@ -0,0 +1,347 @@
+/*
+    Author: Alex Keller, Ryan Leacock, Jimmy Finnegan, Graham Baker
+    Purpose: Tour representations the improvement passes work on (next/prev/between/reverse)
+*/
+
+#ifndef TSP_TOUR_H
+#define TSP_TOUR_H
+
+#include <algorithm>
+#include <vector>
+
+
+/*
+    Tour as an order array plus each city's position in it.
+
+    next/prev/between are O(1). reverse(a, b) flips the path a..b in place; it flips whichever
+    of a..b and the rest of the tour is shorter (same cycle either way), so it costs at most n/2
+    swaps. After a reverse the tour may run the other way round: callers re-ask next/prev.
+*/
+class ArrayTour {
+public:
+    //From the closed format the solvers print (0 ... 0)
+    explicit ArrayTour(const std::vector<int>& closed)
+        : order(closed.begin(), closed.end() - 1), pos(order.size()) {
+        for (int i = 0; i < size(); i++) pos[order[i]] = i;
+    }
+
+    int size() const { return (int)order.size(); }
+    int next(int a) const { return order[pos[a] + 1 == size() ? 0 : pos[a] + 1]; }
+    int prev(int a) const { return order[pos[a] == 0 ? size() - 1 : pos[a] - 1]; }
+
+    //True if b is on the forward path from a to c (ends included)
+    bool between(int a, int b, int c) const {
+        int pa = pos[a], pb = pos[b], pc = pos[c];
+        if (pa <= pc) return pa <= pb && pb <= pc;
+        return pb >= pa || pb <= pc;
+    }
+
+    //Reverses the forward path a..b: prev(a) ends up next to b and a next to the old next(b)
+    void reverse(int a, int b) {
+        int n = size();
+        int i = pos[a], j = pos[b];
+        int len = j - i + 1;
+        if (len <= 0) len += n;
+        if (2 * len > n) {
+            //The complement next(b)..prev(a) is shorter
+            i = (pos[b] + 1) % n;
+            j = (pos[a] + n - 1) % n;
+            len = n - len;
+        }
+        for (int s = 0; s < len / 2; s++) {
+            int ci = order[i], cj = order[j];
+            order[i] = cj;
+            pos[cj] = i;
+            order[j] = ci;
+            pos[ci] = j;
+            if (++i == n) i = 0;
+            if (--j < 0) j = n - 1;
+        }
+    }
+
+    //No edge is off limits (see PathTour)
+    bool fixed(int, int) const { return false; }
+
+    //Back to 0 ... 0
+    std::vector<int> closed() const {
+        std::vector<int> t(size() + 1);
+        int c = 0;
+        for (int i = 0; i < size(); i++, c = next(c)) t[i] = c;
+        t[size()] = 0;
+        return t;
+    }
+
+private:
+    std::vector<int> order, pos;
+};
+
+
+/*
+    Two-level list tour for big n, where ArrayTour's O(n) reversals dominate.
+
+    The tour is a ring of segments (about sqrt(n) of them, linked both ways and numbered by
+    rank), each holding its cities in an array with a reversal bit. next/prev/between are O(1):
+    a city's place is its segment's rank plus its position inside the segment. Ranks are spread
+    out so a new segment can take the middle of a gap without renumbering the ring.
+
+    reverse(a, b):
+        1) a..b (or the rest of the tour) is at most a segment long: swap cities end to end,
+           slot by slot, even across segment borders
+        2) Otherwise split segments so a starts one and b ends one (O(sqrt n) copying)
+        3) Reverse the shorter of that run of segments and the rest of the ring: relink it
+           backwards and flip each segment's bit, O(sqrt n)
+        4) Splits add segments; once there are twice as many as at the start, rebuild them all
+           (O(n), but only every sqrt(n) or so reversals)
+*/
+class TwoLevelTour {
+public:
+    explicit TwoLevelTour(const std::vector<int>& closed)
+        : segOf(closed.size() - 1), idx(closed.size() - 1) {
+        n = (int)closed.size() - 1;
+        groupSize = 8;
+        while ((long long)groupSize * groupSize < n) groupSize++;
+        rebuild(std::vector<int>(closed.begin(), closed.end() - 1));
+    }
+
+    int size() const { return n; }
+
+    int next(int a) const {
+        const Segment& s = segs[segOf[a]];
+        int k = place(a) + 1;
+        if (k < (int)s.cities.size()) return at(s, k);
+        return at(segs[s.next], 0);
+    }
+
+    int prev(int a) const {
+        const Segment& s = segs[segOf[a]];
+        int k = place(a) - 1;
+        if (k >= 0) return at(s, k);
+        const Segment& p = segs[s.prev];
+        return at(p, (int)p.cities.size() - 1);
+    }
+
+    //True if b is on the forward path from a to c (ends included)
+    bool between(int a, int b, int c) const {
+        long long ka = key(a), kb = key(b), kc = key(c);
+        if (ka <= kc) return ka <= kb && kb <= kc;
+        return kb >= ka || kb <= kc;
+    }
+
+    //Reverses the forward path a..b: prev(a) ends up next to b and a next to the old next(b)
+    void reverse(int a, int b) {
+        if (a == b) return;
+        int len = pathLength(a, b, groupSize);
+        if (len <= groupSize) {
+            swapReverse(a, b, len);
+            return;
+        }
+        int c = next(b), d = prev(a);
+        if (c == a) return;   //a..b is the whole tour: reversing it changes nothing
+        len = pathLength(c, d, groupSize);
+        if (len <= groupSize) {
+            swapReverse(c, d, len);
+            return;
+        }
+
+        if (place(a) > 0) split(segOf[a], place(a));
+        if (place(b) + 1 < (int)segs[segOf[b]].cities.size()) split(segOf[b], place(b) + 1);
+
+        //Run of whole segments first..last; take the rest of the ring instead if it is shorter
+        //(walk both at once, so this costs the shorter one)
+        int first = segOf[a], last = segOf[b];
+        int restFirst = segs[last].next, restLast = segs[first].prev;
+        if (restFirst == first) return;
+        for (int x = first, y = restFirst;; x = segs[x].next, y = segs[y].next) {
+            if (x == last) break;
+            if (y == restLast) {
+                first = restFirst;
+                last = restLast;
+                break;
+            }
+        }
+        reverseRun(first, last);
+
+        if (liveSegs > 2 * startSegs) rebuild(order());
+    }
+
+    bool fixed(int, int) const { return false; }
+
+    //Back to 0 ... 0
+    std::vector<int> closed() const {
+        std::vector<int> t(n + 1);
+        int c = 0;
+        for (int i = 0; i < n; i++, c = next(c)) t[i] = c;
+        t[n] = 0;
+        return t;
+    }
+
+private:
+    struct Segment {
+        std::vector<int> cities;   //in array order; read backwards when rev is set
+        bool rev = false;
+        int prev = 0, next = 0;
+        long long rank = 0;
+    };
+
+    static const long long rankGap = 1LL << 20;
+
+    int n = 0, groupSize = 8, liveSegs = 0, startSegs = 0;
+    std::vector<Segment> segs;
+    std::vector<int> segOf, idx;   //each city's segment and its index in that segment's array
+    std::vector<int> run;          //scratch for reverseRun
+
+    //Position of a city inside its segment, in tour direction
+    int place(int a) const {
+        const Segment& s = segs[segOf[a]];
+        return s.rev ? (int)s.cities.size() - 1 - idx[a] : idx[a];
+    }
+
+    int at(const Segment& s, int k) const {
+        return s.rev ? s.cities[s.cities.size() - 1 - k] : s.cities[k];
+    }
+
+    long long key(int a) const {
+        return segs[segOf[a]].rank * (n + 1) + place(a);
+    }
+
+    //Cities in tour order, starting at city 0
+    std::vector<int> order() const {
+        std::vector<int> o(n);
+        int c = 0;
+        for (int i = 0; i < n; i++, c = next(c)) o[i] = c;
+        return o;
+    }
+
+    void rebuild(const std::vector<int>& o) {
+        int m = (n + groupSize - 1) / groupSize;
+        segs.assign(m, Segment());
+        for (int s = 0; s < m; s++) {
+            Segment& seg = segs[s];
+            seg.cities.assign(o.begin() + (size_t)s * groupSize, o.begin() + std::min((size_t)n, (size_t)(s + 1) * groupSize));
+            seg.prev = (s + m - 1) % m;
+            seg.next = (s + 1) % m;
+            seg.rank = s * rankGap;
+            for (int i = 0; i < (int)seg.cities.size(); i++) {
+                segOf[seg.cities[i]] = s;
+                idx[seg.cities[i]] = i;
+            }
+        }
+        liveSegs = startSegs = m;
+    }
+
+    //Spreads the ranks out again, keeping the ring's order (only when a gap runs out)
+    void renumber(int from) {
+        int s = from;
+        for (int r = 0; r < liveSegs; r++, s = segs[s].next) segs[s].rank = r * rankGap;
+    }
+
+    //Cities on the forward path a..b, or limit + 1 if there are more than limit
+    int pathLength(int a, int b, int limit) const {
+        if (segOf[a] == segOf[b] && place(a) <= place(b)) return place(b) - place(a) + 1;
+        int len = (int)segs[segOf[a]].cities.size() - place(a);
+        for (int s = segs[segOf[a]].next; len <= limit; s = segs[s].next) {
+            if (s == segOf[b]) return len + place(b) + 1;
+            len += (int)segs[s].cities.size();
+        }
+        return limit + 1;
+    }
+
+    //Reverses the len cities a..b by swapping them between their slots, outside in
+    void swapReverse(int a, int b, int len) {
+        for (int k = 0; k < len / 2; k++) {
+            int na = next(a), pb = prev(b);
+            int sa = segOf[a], ia = idx[a], sb = segOf[b], ib = idx[b];
+            segs[sa].cities[ia] = b;
+            segs[sb].cities[ib] = a;
+            segOf[a] = sb;
+            idx[a] = ib;
+            segOf[b] = sa;
+            idx[b] = ia;
+            a = na;
+            b = pb;
+        }
+    }
+
+    //Cuts segment s after its first k cities (tour direction); the rest becomes a new segment after it
+    void split(int s, int k) {
+        int t = (int)segs.size();
+        segs.emplace_back();
+        Segment& seg = segs[s];
+        Segment& tail = segs[t];
+        int size = (int)seg.cities.size();
+        if (!seg.rev) {
+            tail.cities.assign(seg.cities.begin() + k, seg.cities.end());
+            seg.cities.resize(k);
+        } else {
+            //Backwards, the first k cities are the array's last k
+            tail.cities.assign(seg.cities.begin(), seg.cities.begin() + (size - k));
+            seg.cities.erase(seg.cities.begin(), seg.cities.begin() + (size - k));
+            for (int i = 0; i < k; i++) idx[seg.cities[i]] = i;
+        }
+        tail.rev = seg.rev;
+        for (int i = 0; i < (int)tail.cities.size(); i++) {
+            segOf[tail.cities[i]] = t;
+            idx[tail.cities[i]] = i;
+        }
+
+        tail.prev = s;
+        tail.next = seg.next;
+        segs[seg.next].prev = t;
+        seg.next = t;
+        liveSegs++;
+
+        //Take the middle of the gap up to the next segment (the ring's highest rank has room above it)
+        long long after = segs[tail.next].rank;
+        if (after <= seg.rank) tail.rank = seg.rank + rankGap;
+        else if (after - seg.rank >= 2) tail.rank = seg.rank + (after - seg.rank) / 2;
+        else renumber(s);
+    }
+
+    //Reverses the run of segments first..last (following next) in the ring
+    void reverseRun(int first, int last) {
+        int before = segs[first].prev, after = segs[last].next;
+        run.clear();
+        for (int s = first;; s = segs[s].next) {
+            run.push_back(s);
+            if (s == last) break;
+        }
+
+        //before -> last ... first -> after, each one read the other way; the run's ranks stay
+        //where they were, so the rest of the ring needs no renumbering
+        int r = (int)run.size();
+        for (int j = 0; j < r / 2; j++) std::swap(segs[run[j]].rank, segs[run[r - 1 - j]].rank);
+        int p = before;
+        for (int i = r - 1; i >= 0; i--) {
+            int s = run[i];
+            segs[s].rev = !segs[s].rev;
+            segs[s].prev = p;
+            segs[p].next = s;
+            p = s;
+        }
+        segs[p].next = after;
+        segs[after].prev = p;
+    }
+};
+
+
+//A tour used as is (the default for code that can also take a PathTour)
+template <class Base>
+class PlainTour : public Base {
+public:
+    explicit PlainTour(const std::vector<int>& closed) : Base(closed) {}
+};
+
+//A path stored as a tour: the closing edge from its last city back to its first may never be broken
+template <class Base>
+class PathTour : public Base {
+public:
+    explicit PathTour(const std::vector<int>& closed)
+        : Base(closed), first(closed[0]), last(closed[closed.size() - 2]) {}
+
+    bool fixed(int a, int b) const { return (a == first && b == last) || (a == last && b == first); }
+
+private:
+    int first, last;
+};
+
+#endif